@@ -1,6 +1,90 @@
+#include <cstddef>
+
 #include "ast.hh"
 
 
+/*******************************************************
+ *** The node arena.                                 ***
+ *******************************************************/
+
+node_arena ast_arena;
+
+// Every allocation is rounded up to this, so that all nodes are aligned.
+static const size_t ARENA_ALIGNMENT = alignof(max_align_t);
+
+// The nodes of a chunk start this far into it.
+static const size_t ARENA_HEADER_SIZE =
+    (sizeof(arena_chunk) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+
+
+/* Hand out size bytes from the current chunk, moving on to a new chunk when
+   it is full. A request larger than a standard chunk gets a chunk of its own,
+   so it works for any size - but AST nodes are all small. */
+void *node_arena::allocate(size_t size)
+{
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+
+    if (current == NULL || used + size > current->size) {
+        arena_chunk *chunk;
+        if (spare != NULL && size <= spare->size) {
+            chunk = spare;
+            spare = NULL;
+        } else {
+            size_t chunk_size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+            chunk = (arena_chunk *) new char[ARENA_HEADER_SIZE + chunk_size];
+            chunk->size = chunk_size;
+        }
+        chunk->previous = current;
+        current = chunk;
+        used = 0;
+    }
+
+    void *p = (char *) current + ARENA_HEADER_SIZE + used;
+    used += size;
+    return p;
+}
+
+
+/* Return the current position, to be given to release() later on. */
+arena_mark node_arena::mark()
+{
+    arena_mark m;
+    m.chunk = current;
+    m.used = used;
+    return m;
+}
+
+
+/* Free all chunks allocated after the mark was taken, and rewind the chunk
+   that was current at the time. One standard chunk is kept as a spare. */
+void node_arena::release(const arena_mark &m)
+{
+    while (current != m.chunk) {
+        arena_chunk *chunk = current;
+        current = chunk->previous;
+        if (spare == NULL && chunk->size == ARENA_CHUNK_SIZE) {
+            spare = chunk;
+        } else {
+            delete[] (char *) chunk;
+        }
+    }
+    used = m.used;
+}
+
+
+void *operator new(size_t size, node_arena &arena)
+{
+    return arena.allocate(size);
+}
+
+
+/* Only called if a constructor throws, and the memory goes with the arena
+   anyway. */
+void operator delete(void *, node_arena &)
+{
+}
+
+
 /*******************************************************
  *** The abstract AST classes - never used directly. ***
  *******************************************************/
@@ -16,6 +100,18 @@ ast_node::ast_node(position_information *p) :
 }
 
 
+void *ast_node::operator new(size_t size)
+{
+    return ast_arena.allocate(size);
+}
+
+
+/* Nodes are freed by releasing the arena, see node_arena. */
+void ast_node::operator delete(void *)
+{
+}
+
+
 /* The ast_statement class. */
 ast_statement::ast_statement(position_information *p) :
     ast_node(p)
@@ -149,6 +149,7 @@ class ast_binaryrelation;
 class ast_unaryoperation;
 class ast_stmt_list;
 class ast_id;
+class ast_indexed;
 class ast_integer;
 class ast_real;
 class ast_cast;
@@ -157,6 +158,74 @@ class quad_list;
 
 
 
+/*** Node storage ***/
+
+// Bytes in a standard arena chunk. Larger requests get a chunk of their own.
+const size_t ARENA_CHUNK_SIZE = 65536;
+
+/* A chunk of arena memory. The nodes are stored right after this header. */
+struct arena_chunk
+{
+    // The chunk allocated before this one, if any.
+    arena_chunk *previous;
+
+    // Bytes available after the header.
+    size_t size;
+};
+
+
+/* A position in a node_arena, used to free everything allocated after it. */
+struct arena_mark
+{
+    arena_chunk *chunk;
+    size_t used;
+};
+
+
+/* Arena for AST nodes and the position_information they point to. The AST
+   of a block is dead once its code has been generated, so rather than
+   allocating and never freeing every node separately, nodes are handed out
+   by bumping a pointer in a large chunk, and the whole AST of a block is
+   given back at once by releasing the arena to a mark taken before the block
+   was parsed. Marks are released in the reverse order they were taken,
+   which is how blocks nest anyway.
+
+   The class has no constructor on purpose: a global node_arena is zeroed
+   before any constructor runs, so it may be used during static
+   initialization. An empty arena gets its first chunk when it is needed. */
+class node_arena
+{
+private:
+    // The chunk currently being allocated from.
+    arena_chunk *current;
+
+    // Bytes used in the current chunk.
+    size_t used;
+
+    // A standard chunk kept after a release, so that the next block doesn't
+    // have to allocate it again.
+    arena_chunk *spare;
+
+public:
+    // Return size bytes of memory, aligned for any node.
+    void *allocate(size_t);
+
+    // Return the current position in the arena.
+    arena_mark mark();
+
+    // Free everything allocated since the mark was taken.
+    void release(const arena_mark &);
+};
+
+// Holds the AST nodes. Defined in ast.cc.
+extern node_arena ast_arena;
+
+// Used as 'new (ast_arena) position_information(...)' in parser.y.
+void *operator new(size_t, node_arena &);
+void operator delete(void *, node_arena &);
+
+
+
 /*** Abstract classes ***/
 
 /* Base class for all ast nodes. */
@@ -195,6 +264,11 @@ public:
     // Constructor.
     ast_node(position_information *);
 
+    // All nodes live in ast_arena. They are never deleted one by one, the
+    // arena frees them together.
+    static void *operator new(size_t);
+    static void operator delete(void *);
+
     // Perform type checking. See semantic.cc for the method bodies.
     // Note that it's an error to call type_check in this class. It should
     // only be called in the concrete AST nodes, see below.
@@ -255,6 +329,12 @@ public:
 
     virtual sym_index generate_quads(quad_list &) = 0;
 
+    // Generate quads evaluating the expression as a condition, which jump
+    // to a label if it is false (or true), and else fall through. Args:
+    // quad list, label.
+    virtual void generate_jump_if_false(quad_list &, int);
+    virtual void generate_jump_if_true(quad_list &, int);
+
     // Used for safe downcasting. We could provide a mechanism to safely
     // downcast ALL ast nodes... But these ones are the only ones we'll need
     // in this lab course. They will be used during AST optimization.
@@ -273,6 +353,10 @@ public:
         return NULL;
     }
 
+    virtual ast_indexed *get_ast_indexed() {
+        return NULL;
+    }
+
     virtual ast_cast *get_ast_cast() {
         return NULL;
     }
@@ -827,6 +911,10 @@ public:
     // Quad generation.
     virtual sym_index generate_quads(quad_list &);
 
+    // Jumping code for conditions, evaluating no more than needed.
+    virtual void generate_jump_if_false(quad_list &, int);
+    virtual void generate_jump_if_true(quad_list &, int);
+
     virtual ast_not *get_ast_unaryoperation() {
         return this;
     }
@@ -1086,6 +1174,10 @@ public:
     // Quad generation.
     virtual sym_index generate_quads(quad_list &);
 
+    // Jumping code for conditions, evaluating no more than needed.
+    virtual void generate_jump_if_false(quad_list &, int);
+    virtual void generate_jump_if_true(quad_list &, int);
+
     // Safe downcasts.
     virtual ast_or *get_ast_binaryoperation() {
         return this;
@@ -1110,6 +1202,10 @@ public:
     // Quad generation.
     virtual sym_index generate_quads(quad_list &);
 
+    // Jumping code for conditions, evaluating no more than needed.
+    virtual void generate_jump_if_false(quad_list &, int);
+    virtual void generate_jump_if_true(quad_list &, int);
+
     // Safe downcasts.
     virtual ast_and *get_ast_binaryoperation() {
         return this;
@@ -1275,6 +1371,11 @@ public:
     virtual sym_index generate_quads(quad_list &);
 
     virtual void generate_assignment(quad_list &, sym_index);
+
+    // Safe downcasting.
+    virtual ast_indexed *get_ast_indexed() {
+        return this;
+    }
 };
 
 
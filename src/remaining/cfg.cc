@@ -0,0 +1,309 @@
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <assert.h>
+#include "symtab.hh"
+#include "quads.hh"
+#include "cfg.hh"
+
+using namespace std;
+
+
+/* The bit_set class. */
+static const long WORD_BITS = 8 * sizeof(unsigned long);
+
+bit_set::bit_set(const long size) :
+    words((size + WORD_BITS - 1) / WORD_BITS, 0)
+{
+}
+
+
+void bit_set::insert(const long n)
+{
+    words[n / WORD_BITS] |= 1UL << (n % WORD_BITS);
+}
+
+
+void bit_set::erase(const long n)
+{
+    words[n / WORD_BITS] &= ~(1UL << (n % WORD_BITS));
+}
+
+
+bool bit_set::contains(const long n) const
+{
+    return (words[n / WORD_BITS] >> (n % WORD_BITS)) & 1;
+}
+
+
+bool bit_set::unite(const bit_set &s)
+{
+    bool grew = false;
+    for (unsigned long i = 0; i < words.size(); i++) {
+        unsigned long w = words[i] | s.words[i];
+        grew |= w != words[i];
+        words[i] = w;
+    }
+    return grew;
+}
+
+
+void bit_set::subtract(const bit_set &s)
+{
+    for (unsigned long i = 0; i < words.size(); i++) {
+        words[i] &= ~s.words[i];
+    }
+}
+
+
+bool bit_set::operator==(const bit_set &s) const
+{
+    return words == s.words;
+}
+
+
+
+/* The basic_block class. */
+basic_block::basic_block(long n) :
+    number(n)
+{
+}
+
+
+long basic_block::label()
+{
+    if (quads.empty() || quads[0].op_code != q_labl) {
+        return -1;
+    }
+    return quads[0].int1;
+}
+
+
+quadruple *basic_block::last_quad()
+{
+    if (quads.empty()) {
+        return NULL;
+    }
+    return &quads.back();
+}
+
+
+
+/* The control_flow_graph class. */
+
+/* Split the quad list into basic blocks. A new block is started by the first
+   quad, by every label and by every quad following one that ends a block. */
+control_flow_graph::control_flow_graph(quad_list *q_list) :
+    last_label(q_list->last_label)
+{
+    quad_list_iterator ql_iterator(q_list);
+
+    for (quadruple *q = ql_iterator.get_current();
+         q != NULL;
+         q = ql_iterator.get_next()) {
+        if (blocks.empty() ||
+            q->op_code == q_labl ||
+            ends_block(blocks.back().quads.back())) {
+            blocks.push_back(basic_block(blocks.size()));
+        }
+        blocks.back().quads.push_back(*q);
+    }
+
+    build_edges();
+}
+
+
+bool control_flow_graph::ends_block(const quadruple &q)
+{
+    switch (q.op_code) {
+    case q_jmp:
+    case q_jmpf:
+    case q_ireturn:
+    case q_rreturn:
+    case q_call:
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+/* A block is followed by the next one unless it ends with an unconditional
+   jump. Jumps and returns go to the block starting with their label. */
+void control_flow_graph::build_edges()
+{
+    map<long, long> label_block;
+
+    for (unsigned long i = 0; i < blocks.size(); i++) {
+        blocks[i].successors.clear();
+        blocks[i].predecessors.clear();
+        if (blocks[i].label() != -1) {
+            label_block[blocks[i].label()] = i;
+        }
+    }
+
+    for (unsigned long i = 0; i < blocks.size(); i++) {
+        quadruple *last = blocks[i].last_quad();
+        bool falls_through = true;
+
+        if (last != NULL) {
+            switch (last->op_code) {
+            case q_jmp:
+            case q_ireturn:
+            case q_rreturn:
+                falls_through = false;
+                // Fall through.
+            case q_jmpf:
+                if (label_block.find(last->int1) == label_block.end()) {
+                    fatal("control_flow_graph: jump to unknown label");
+                }
+                blocks[i].successors.push_back(label_block[last->int1]);
+                break;
+            default:
+                break;
+            }
+        }
+
+        // A q_jmpf to the very next block only has one successor.
+        if (falls_through && i + 1 < blocks.size() &&
+            (blocks[i].successors.empty() ||
+             blocks[i].successors[0] != (long) i + 1)) {
+            blocks[i].successors.push_back(i + 1);
+        }
+    }
+
+    for (unsigned long i = 0; i < blocks.size(); i++) {
+        for (unsigned long j = 0; j < blocks[i].successors.size(); j++) {
+            blocks[blocks[i].successors[j]].predecessors.push_back(i);
+        }
+    }
+}
+
+
+long control_flow_graph::size()
+{
+    return blocks.size();
+}
+
+
+basic_block &control_flow_graph::operator[](const long b)
+{
+    assert(b >= 0 && b < size());
+    return blocks[b];
+}
+
+
+/* Insert a quad into a block. A label may only be inserted first in a block,
+   and a quad ending a block only last, or the block wouldn't be one. */
+void control_flow_graph::insert(const long b, const long pos,
+                                const quadruple &q)
+{
+    basic_block &block = (*this)[b];
+    assert(pos >= 0 && pos <= (long) block.quads.size());
+
+    if ((q.op_code == q_labl && (pos != 0 || block.label() != -1)) ||
+        (ends_block(q) && pos != (long) block.quads.size()) ||
+        (block.last_quad() != NULL && ends_block(*block.last_quad()) &&
+         pos == (long) block.quads.size())) {
+        fatal("control_flow_graph::insert: quad would split a basic block");
+    }
+
+    block.quads.insert(block.quads.begin() + pos, q);
+
+    if (q.op_code == q_labl || ends_block(q)) {
+        build_edges();
+    }
+}
+
+
+/* Delete a quad. A block may become empty, in which case control simply
+   passes on to the next block. */
+void control_flow_graph::remove(const long b, const long pos)
+{
+    basic_block &block = (*this)[b];
+    assert(pos >= 0 && pos < (long) block.quads.size());
+
+    quadruple old = block.quads[pos];
+    block.quads.erase(block.quads.begin() + pos);
+
+    if (old.op_code == q_labl || ends_block(old)) {
+        build_edges();
+    }
+}
+
+
+/* Replace a quad. Quads affecting control flow may only be replaced by quads
+   that can stand in the same place. */
+void control_flow_graph::replace(const long b, const long pos,
+                                 const quadruple &q)
+{
+    basic_block &block = (*this)[b];
+    assert(pos >= 0 && pos < (long) block.quads.size());
+
+    quadruple old = block.quads[pos];
+
+    if ((q.op_code == q_labl && pos != 0) ||
+        (ends_block(q) && pos != (long) block.quads.size() - 1)) {
+        fatal("control_flow_graph::replace: quad would split a basic block");
+    }
+
+    block.quads[pos] = q;
+
+    if (old.op_code == q_labl || ends_block(old) ||
+        q.op_code == q_labl || ends_block(q)) {
+        build_edges();
+    }
+}
+
+
+quad_list *control_flow_graph::linearize()
+{
+    quad_list *q = new quad_list(last_label);
+
+    for (unsigned long i = 0; i < blocks.size(); i++) {
+        for (unsigned long j = 0; j < blocks[i].quads.size(); j++) {
+            (*q) += blocks[i].quads[j];
+        }
+    }
+
+    return q;
+}
+
+
+/* Print the blocks with their edges and quads. The quads are numbered
+   through the whole graph, the same way a quad list is. */
+void control_flow_graph::print(ostream &o)
+{
+    long quad_nr = 1;
+
+    o << short_symbols;
+
+    for (unsigned long i = 0; i < blocks.size(); i++) {
+        o << "B" << i << ":  pred";
+        for (unsigned long j = 0; j < blocks[i].predecessors.size(); j++) {
+            o << " B" << blocks[i].predecessors[j];
+        }
+        o << "  succ";
+        for (unsigned long j = 0; j < blocks[i].successors.size(); j++) {
+            o << " B" << blocks[i].successors[j];
+        }
+        o << endl;
+
+        for (unsigned long j = 0; j < blocks[i].quads.size(); j++) {
+            o << setw(5) << quad_nr++ << &blocks[i].quads[j] << endl;
+        }
+    }
+
+    o << long_symbols;
+}
+
+
+ostream &operator<<(ostream &o, control_flow_graph *cfg)
+{
+    if (cfg != NULL) {
+        cfg->print(o);
+    } else {
+        o << "CFG: NULL" << endl;
+    }
+    return o;
+}
@@ -0,0 +1,120 @@
+#ifndef __CFG_HH__
+#define __CFG_HH__
+
+#include <vector>
+
+#include "quads.hh"
+
+using namespace std;
+
+
+/* A set of small non-negative numbers, such as definition or temporary
+   numbers, stored as one bit each. This is what the data flow analyses over
+   a control_flow_graph compute with. */
+class bit_set
+{
+private:
+    vector<unsigned long> words;
+
+public:
+    // Constructor. Arg: the numbers will be less than this.
+    bit_set(const long = 0);
+
+    void insert(const long);
+
+    void erase(const long);
+
+    bool contains(const long) const;
+
+    // Add all members of another set. Returns true if this set grew.
+    bool unite(const bit_set &);
+
+    // Remove all members of another set.
+    void subtract(const bit_set &);
+
+    bool operator==(const bit_set &) const;
+};
+
+
+/* A basic block is a maximal sequence of quads that is always executed from
+   the first to the last: control can only enter at the top and only leave at
+   the bottom. A block starts at a q_labl (or after a quad ending a block) and
+   ends with a q_jmp, q_jmpf, q_ireturn, q_rreturn or q_call. A q_call ends a
+   block too, since the called procedure may change any variable it can see.
+   Blocks are numbered in the order they appear in the quad list. */
+class basic_block
+{
+public:
+    // Position of the block in its control_flow_graph.
+    long number;
+
+    // The quads of the block, in order.
+    vector<quadruple> quads;
+
+    // Numbers of the blocks control may continue in after this one, and of
+    // the blocks it may come from.
+    vector<long> successors;
+    vector<long> predecessors;
+
+    basic_block(long);
+
+    // The label starting the block, or -1 if it doesn't start with one.
+    long label();
+
+    // The last quad of the block, or NULL if the block is empty.
+    quadruple *last_quad();
+};
+
+
+/* The control flow graph of a quad list. The quads are copied into basic
+   blocks, where passes over the code may look at and edit them block by
+   block. linearize() puts the blocks back together into a quad list for the
+   code generator. Quads affecting control flow must be edited through the
+   graph, so that the edges stay right; other quads may be edited in their
+   block directly. */
+class control_flow_graph
+{
+private:
+    // The blocks, in quad list order.
+    vector<basic_block> blocks;
+
+    // The last_label of the quad list the graph was built from.
+    int last_label;
+
+    // Return true if a quad may transfer control anywhere but to the next
+    // quad, ie, if it must be the last quad of its block.
+    static bool ends_block(const quadruple &);
+
+    // Calculate successors and predecessors of all blocks.
+    void build_edges();
+
+    void print(ostream &);
+
+public:
+    // Constructor. Arg: the quads to build the graph from.
+    control_flow_graph(quad_list *);
+
+    // Number of blocks.
+    long size();
+
+    // The block with a given number.
+    basic_block &operator[](const long);
+
+    // Insert a quad into a block, before the quad at a given position.
+    // Args: block number, position within block, the quad.
+    void insert(const long, const long, const quadruple &);
+
+    // Delete the quad at a given position of a block.
+    void remove(const long, const long);
+
+    // Replace the quad at a given position of a block.
+    void replace(const long, const long, const quadruple &);
+
+    // Return a new quad list holding the quads of all blocks, in order.
+    quad_list *linearize();
+
+    friend ostream &operator<<(ostream &, control_flow_graph *);
+};
+
+
+#endif
@@ -25,6 +25,22 @@ code_generator::code_generator(const string object_file_name)
     reg[RAX] = "rax";
     reg[RCX] = "rcx";
     reg[RDX] = "rdx";
+    reg[RBX] = "rbx";
+    reg[RSI] = "rsi";
+    reg[RDI] = "rdi";
+    reg[R8] = "r8";
+    reg[R9] = "r9";
+    reg[R10] = "r10";
+    reg[R11] = "r11";
+    reg[R12] = "r12";
+    reg[R13] = "r13";
+    reg[R14] = "r14";
+    reg[R15] = "r15";
+    reg[RBP] = "rbp";
+    for (int i = 0; i < 16; i++) {
+        reg[XMM0 + i] = "xmm" + to_string(i);
+    }
+    static_size = 0;
 }
 
 
@@ -43,9 +59,85 @@ code_generator::~code_generator()
    the symbol for the environment for which code is being generated. */
 void code_generator::generate_assembler(quad_list *q, symbol *env)
 {
+    // Find the registers the block uses, in the order they are handed out,
+    // how many times each value is used, and how many times the activation
+    // record of each outer block is.
+    vector<bool> used(REGISTER_COUNT, false);
+    map<int, long> outer_uses;
+    uses.clear();
+    current_level = env->level + 1;
+    for (long i = 0; i < q->size(); i++) {
+        quadruple &quad = (*q)[i];
+        for (int arg = 1; arg <= 3; arg++) {
+            sym_index sym_p = NULL_SYM;
+            if (quad.reads(arg)) {
+                sym_p = quad.get_arg(arg);
+            } else if (arg == 3) {
+                sym_p = quad.writes();
+            } else if (arg == 1 && (quad.op_code == q_lindex ||
+                                    quad.op_code == q_irindex ||
+                                    quad.op_code == q_rrindex)) {
+                // the array indexed
+                sym_p = quad.sym1;
+            }
+            if (sym_p == NULL_SYM) {
+                continue;
+            }
+            if (register_of(sym_p) != NO_REGISTER) {
+                used[register_of(sym_p)] = true;
+            } else if (!sym_tab->is_temp(sym_p) && !is_static(sym_p)) {
+                symbol *sym = sym_tab->get_symbol(sym_p);
+                if ((sym->tag == SYM_VAR || sym->tag == SYM_ARRAY ||
+                     sym->tag == SYM_PARAM) && sym->level != current_level) {
+                    outer_uses[sym->level]++;
+                }
+            }
+            if (quad.reads(arg)) {
+                uses[sym_p]++;
+            }
+        }
+    }
+
+    // Keep the outer activation record used the most in DISPLAY_REGISTER,
+    // unless the quad optimizer has handed that out.
+    display_level = -1;
+    if (!used[DISPLAY_REGISTER]) {
+        long most = 0;
+        map<int, long>::iterator it;
+        for (it = outer_uses.begin(); it != outer_uses.end(); it++) {
+            if (it->second > most) {
+                display_level = it->first;
+                most = it->second;
+            }
+        }
+        if (display_level != -1) {
+            used[DISPLAY_REGISTER] = true;
+        }
+    }
+    saved_registers.clear();
+    for (int r = 0; r < ALLOCATABLE_REGISTERS; r++) {
+        if (used[allocatable[r]]) {
+            saved_registers.push_back(allocatable[r]);
+        }
+    }
+    for (int r = 0; r < ALLOCATABLE_XMM_REGISTERS; r++) {
+        if (used[allocatable_xmm[r]]) {
+            saved_registers.push_back(allocatable_xmm[r]);
+        }
+    }
+
     prologue(env);
     expand(q);
     epilogue(env);
+
+    // The main program comes last, after everything using static storage.
+    if (current_level == GLOBAL_LEVEL && static_size > 0) {
+        out << "\t\t" << ".bss" << endl;
+        out << "\t\t" << ".align" << "\t" << STACK_WIDTH << endl;
+        out << "\t\t" << ".zero" << "\t" << static_size << endl;
+        out << "GLOBALS:" << "\t\t" << "# end of static storage" << endl;
+        out << flush;
+    }
 }
 
 
@@ -94,7 +186,7 @@ void code_generator::prologue(symbol *new_env)
     /* Print out the label number (a SYM_PROC/ SYM_FUNC attribute) */
     out << "L" << label_nr << ":" << "\t\t\t" << "# " <<
         /* Print out the function/procedure name */
-        sym_tab->pool_lookup(new_env->id) << endl;
+        sym_tab->pool_view(new_env->id) << endl;
 
     if (assembler_trace) {
         out << "\t\t" << "# PROLOGUE (" << short_symbols << new_env
@@ -116,6 +208,17 @@ void code_generator::prologue(symbol *new_env)
     out << "\t\t" << "mov" << "\t" << "rbp,rcx" << endl;
     // allocate space for temporary storage    
     out << "\t\t" <<"sub" << "\t" << "rsp," << ar_size << endl;
+
+    // save the registers we are going to use, below the activation record
+    for (unsigned long i = 0; i < saved_registers.size(); i++) {
+        push_register(saved_registers[i]);
+    }
+    saved_offset = STACK_WIDTH * (curr_level + 1) + ar_size +
+                   STACK_WIDTH * saved_registers.size();
+    if (display_level != -1) {
+        out << "\t\t" << "mov" << "\t" << reg[DISPLAY_REGISTER] << ",[rbp-"
+            << STACK_WIDTH * display_level << "]" << endl;
+    }
     out << flush;
 }
 
@@ -128,6 +231,14 @@ void code_generator::epilogue(symbol *old_env)
         out << "\t" << "# EPILOGUE (" << short_symbols << old_env
             << long_symbols << ")" << endl;
     }
+    // restore the saved registers
+    if (!saved_registers.empty()) {
+        out << "\t\t" << "lea" << "\t" << "rsp,[rbp-" << saved_offset << "]"
+            << endl;
+        for (long i = saved_registers.size() - 1; i >= 0; i--) {
+            pop_register(saved_registers[i]);
+        }
+    }
     // release activation record
     out << "\t\t" <<"leave" << endl;
     // return
@@ -141,6 +252,14 @@ void code_generator::epilogue(symbol *old_env)
    array or a parameter. Note the pass-by-pointer arguments. */
 void code_generator::find(sym_index sym_p, int *level, int *offset)
 {
+    // Temporaries are laid out just like local variables.
+    if (sym_tab->is_temp(sym_p)) {
+        temp_info *temp = sym_tab->get_temp(sym_p);
+        *offset = - (STACK_WIDTH * (temp->level + 1) + temp->offset);
+        *level = temp->level;
+        return;
+    }
+
     symbol *sym = sym_tab->get_symbol(sym_p);
     //the question is from where do we count the offset
     if(sym->tag == SYM_PARAM){
@@ -156,6 +275,12 @@ void code_generator::find(sym_index sym_p, int *level, int *offset)
         int offset_area = sym->offset;
         // don't get why its negativ
         *offset = - (display_area + offset_area);
+        // arrays are addressed by their first element, at the bottom, so
+        // that the elements follow it upwards
+        if (sym->tag == SYM_ARRAY) {
+            *offset -= STACK_WIDTH *
+                       (sym->get_array_symbol()->array_cardinality - 1);
+        }
     }else
         fatal("couldnt find strange symbol");
     *level = sym->level;
@@ -164,57 +289,210 @@ void code_generator::find(sym_index sym_p, int *level, int *offset)
 
 /*
  * Generates code for getting the address of a frame for the specified scope level.
+ * The current frame is at rbp, and the one kept in DISPLAY_REGISTER is there;
+ * other ones are loaded from the display.
  */
-void code_generator::frame_address(int level, const register_type dest)
+register_type code_generator::frame_address(int level, const register_type dest)
 {
+    if (level == current_level) {
+        return RBP;
+    }
+    if (level == display_level) {
+        return DISPLAY_REGISTER;
+    }
     // store base address of the corresponding address
     out << "\t\t" << "mov" << "\t"
     << reg[dest] << ",[rbp-"<< STACK_WIDTH * level <<"]"<<endl;
+    return dest;
 }
 
+
+/* This function returns the memory operand of a variable, parameter or array
+   (its first element). Those in static storage are addressed relative to
+   rip. For the others the address of their activation record is loaded into
+   the given register first if need be. */
+string code_generator::memory_operand(sym_index sym_p, register_type scratch)
+{
+    if (is_static(sym_p)) {
+        symbol *sym = sym_tab->get_symbol(sym_p);
+        int size = sym_tab->get_size(sym->type);
+        if (sym->tag == SYM_ARRAY) {
+            size *= sym->get_array_symbol()->array_cardinality;
+        }
+        static_size = max(static_size, sym->offset + size);
+        return "[rip+GLOBALS-" + to_string(sym->offset + size) + "]";
+    }
+
+    int level, offset;
+    find(sym_p, &level, &offset);
+    register_type base = frame_address(level, scratch);
+    return "[" + reg[base] + (offset < 0 ? "" : "+") + to_string(offset) + "]";
+}
+
+
+/* This function returns the memory operand of the array element indexed by
+   a quad, with the index scaled in the operand, or added to the
+   displacement if it is an immediate. The index is fetched into rcx unless
+   it is in a register, and the address of the array into rdx if it is in
+   static storage (which can't be indexed relative to rip) or in an
+   activation record not at hand. */
+string code_generator::element_operand(quadruple *q)
+{
+    if (q->immediate) {
+        string address = memory_operand(q->sym1, RDX);
+        long displacement = STACK_WIDTH * (long) q->int2;
+        return address.substr(0, address.size() - 1) +
+               (displacement < 0 ? "" : "+") + to_string(displacement) + "]";
+    }
+
+    register_type index_reg = operand(q->sym2, RCX);
+    string address = memory_operand(q->sym1, RDX);
+    string base;
+    if (is_static(q->sym1)) {
+        out << "\t\t" << "lea" << "\t" << reg[RDX] << "," << address << endl;
+        base = reg[RDX];
+    } else {
+        // drop the brackets
+        base = address.substr(1, address.size() - 2);
+    }
+    return "[" + base + "+" + reg[index_reg] + "*" + to_string(STACK_WIDTH) +
+           "]";
+}
+
+
+/* This function returns true if a symbol is a variable or an array of the
+   main program, which are kept in static storage. */
+bool is_static(const sym_index sym_p)
+{
+    if (sym_tab->is_temp(sym_p)) {
+        return false;
+    }
+    symbol *sym = sym_tab->get_symbol(sym_p);
+    return (sym->tag == SYM_VAR || sym->tag == SYM_ARRAY) &&
+           sym->level == GLOBAL_LEVEL;
+}
+
+
+/* This function returns the register a temporary or a variable has been
+   given by the quad optimizer, or NO_REGISTER if it is in memory. */
+int code_generator::register_of(sym_index sym_p)
+{
+    if (sym_tab->is_temp(sym_p)) {
+        return sym_tab->get_temp(sym_p)->reg;
+    }
+    symbol *sym = sym_tab->get_symbol(sym_p);
+    if (sym->tag == SYM_VAR) {
+        return sym->get_variable_symbol()->reg;
+    }
+    return NO_REGISTER;
+}
+
+
+/* This function returns a register holding a value, for use as an operand.
+   Values kept in general purpose registers are used where they are, other
+   values are fetched into the scratch register given. (The results of
+   comparing reals are real temporaries, which may be in XMM registers.) */
+register_type code_generator::operand(sym_index sym_p, register_type scratch)
+{
+    int r = register_of(sym_p);
+    if (r != NO_REGISTER && r < XMM0) {
+        return (register_type) r;
+    }
+    fetch(sym_p, scratch);
+    return scratch;
+}
+
+
 /* This function fetches the value of a variable or a constant into a
    register. */
 void code_generator::fetch(sym_index sym_p, register_type dest)
 {
-    symbol *sym = sym_tab->get_symbol(sym_p);
-    int level, offset;
-    find(sym_p,&level, &offset);
+    // Values kept in registers are just copied. Reals are moved as they
+    // are, bit for bit, out of XMM registers.
+    if (register_of(sym_p) != NO_REGISTER) {
+        out << "\t\t" << (register_of(sym_p) >= XMM0 ? "movq" : "mov")
+            << "\t" << reg[dest] << "," << reg[register_of(sym_p)] << endl;
+        return;
+    }
 
-    if(sym->tag == SYM_PARAM){
-        out << "\t\t" <<"mov" << "\t"<< reg[dest]
-        // has positiv offset
-        <<",[rbp+" << offset <<"]" << endl;
-    }else
-    if(sym->tag == SYM_VAR || sym->tag == SYM_ARRAY){
-        // # mov rcx,[rbp-level]
-        frame_address(level, RCX);
-        // # mov rax,[rcx offset]  
-        out << "\t\t" << "mov" << "\t"<< reg[dest]  <<",["<< reg[RCX] << offset << "]" <<endl;
+    // Works for temporaries as well as symbols.
+    sym_type tag = sym_tab->get_symbol_tag(sym_p);
+
+    if(tag == SYM_PARAM || tag == SYM_VAR || tag == SYM_ARRAY){
+        // # mov rax,[rbp offset]
+        string address = memory_operand(sym_p, RCX);
+        out << "\t\t" << "mov" << "\t" << reg[dest] << "," << address
+            << endl;
     }else
-    if(sym->tag == SYM_CONST){
+    if(tag == SYM_CONST){
         fatal("after optimsation there shouldn't exit any constants");
     }
 }
 
-// take the variable  and push  to the fpu stack 
-void code_generator::fetch_float(sym_index sym_p)
+/* This function fetches a real value into an XMM register. */
+void code_generator::fetch_float(sym_index sym_p, register_type dest)
 {
-  // fetch the symbol and do some type checking
-  symbol* sym = sym_tab->get_symbol(sym_p);
-    int level,offset;
-    find(sym_p,&level,&offset);
-
-  if (sym->type == real_type && sym->tag == SYM_VAR) {
-    frame_address(level,RCX);
-    out << "\t\t" << "fld" << "\t" << "qword ptr [" << reg[RCX] << offset << "]" << endl;
-  }else
-  if(sym->type == real_type && sym->tag == SYM_PARAM)
-  {
-    frame_address(level,RCX);
-    out << "\t\t" << "fld" << "\t" << "qword ptr [" << reg[RCX] << "+" << offset << "]" << endl;
-  }else
-    fatal("In fetch_float(): Invalid symbol tag or type, tag needs to be SYM_VAR and type real_type.");
+    // fetch the symbol (or temporary) and do some type checking
+    sym_type tag = sym_tab->get_symbol_tag(sym_p);
+    sym_index type = sym_tab->get_symbol_type(sym_p);
 
+    if (type != real_type) {
+        fatal("In fetch_float(): Invalid symbol type, needs to be real_type.");
+    }
+
+    if (register_of(sym_p) != NO_REGISTER) {
+        out << "\t\t" << "movsd" << "\t" << reg[dest] << ","
+            << reg[register_of(sym_p)] << endl;
+        return;
+    }
+
+    if (tag == SYM_VAR || tag == SYM_PARAM) {
+        string address = memory_operand(sym_p, RCX);
+        out << "\t\t" << "movsd" << "\t" << reg[dest] << ",qword ptr "
+            << address << endl;
+    } else {
+        fatal("In fetch_float(): Invalid symbol tag, needs to be SYM_VAR or SYM_PARAM.");
+    }
+}
+
+
+/* This function returns an XMM register holding a real value, for use as
+   an operand. Like operand(), but for reals. */
+register_type code_generator::float_operand(sym_index sym_p,
+                                            register_type scratch)
+{
+    int r = register_of(sym_p);
+    if (r != NO_REGISTER) {
+        return (register_type) r;
+    }
+    fetch_float(sym_p, scratch);
+    return scratch;
+}
+
+
+
+/* These functions return the second argument of a quad for use as an
+   operand. An immediate is used as it is by the first one, and moved into
+   the scratch register by the second one, which returns a register. Other
+   arguments are handled by operand(). */
+string code_generator::second_operand(quadruple *q, register_type scratch)
+{
+    if (q->immediate) {
+        return to_string(q->int2);
+    }
+    return reg[operand(q->sym2, scratch)];
+}
+
+
+register_type code_generator::second_register(quadruple *q,
+                                              register_type scratch)
+{
+    if (q->immediate) {
+        out << "\t\t" << "mov" << "\t" << reg[scratch] << ", " << q->int2
+            << endl;
+        return scratch;
+    }
+    return operand(q->sym2, scratch);
 }
 
 
@@ -222,67 +500,308 @@ void code_generator::fetch_float(sym_index sym_p)
 /* This function stores the value of a register into a variable. */
 void code_generator::store(register_type src, sym_index sym_p)
 {
-    int level, offset;
-    // here we have to use the level
-    find(sym_p,&level, &offset);
-    symbol *sym = sym_tab->get_symbol(sym_p);
-    if(sym->tag == SYM_PARAM){
-        out << "\t\t" << "mov" << "\t"
-        <<"[rbp+" << offset <<"],"
-        << reg[src] << endl;
-    }else
-    if(sym->tag == SYM_VAR){
+    if (register_of(sym_p) != NO_REGISTER) {
+        out << "\t\t" << (register_of(sym_p) >= XMM0 ? "movq" : "mov")
+            << "\t" << reg[register_of(sym_p)] << "," << reg[src] << endl;
+        return;
+    }
+
+    sym_type tag = sym_tab->get_symbol_tag(sym_p);
+    if(tag == SYM_PARAM || tag == SYM_VAR){
+        // # mov [rbp offset],rax
+        string address = memory_operand(sym_p, RCX);
+        out << "\t\t" << "mov" << "\t" << address << "," << reg[src]
+            << endl;
+    }
+}
+
+/* This function stores the value of an XMM register into a real variable. */
+void code_generator::store_float(register_type src, sym_index sym_p)
+{
+    sym_type tag = sym_tab->get_symbol_tag(sym_p);
+
+    if (sym_tab->get_symbol_type(sym_p) != real_type) {
+        fatal("In store_float(): Invalid symbol type, needs to be real_type.");
+    }
 
-        // # mov rcx,[rbp-level]
-        frame_address(level, RCX);       
-        // output right register
+    if (register_of(sym_p) != NO_REGISTER) {
+        out << "\t\t" << "movsd" << "\t" << reg[register_of(sym_p)] << ","
+            << reg[src] << endl;
+        return;
+    }
 
-        out <<"\t\t" << "mov" <<"\t"<< "[rcx" << offset << "],"
-        << reg[src] << endl;
+    if (tag == SYM_VAR || tag == SYM_PARAM) {
+        string address = memory_operand(sym_p, RCX);
+        out << "\t\t" << "movsd" << "\t" << "qword ptr " << address << ","
+            << reg[src] << endl;
+    } else {
+        fatal("In store_float(): Invalid symbol tag, needs to be SYM_VAR or SYM_PARAM.");
     }
 }
 
-void code_generator::store_float(sym_index sym_p)
+
+/* These functions save a register on the stack and restore it. XMM registers
+   can't be pushed, so they are moved to and from the top of the stack. */
+void code_generator::push_register(register_type r)
 {
-  // fetch the symbol and do some type checking
-  symbol* sym = sym_tab->get_symbol(sym_p);
-  if (sym->type == real_type && sym->tag == SYM_VAR) {
-    int level,offset;
-    find(sym_p,&level,&offset);
-    frame_address(level,RCX);
-    out << "\t\t" << "fstp" << "\t" << "qword ptr [" << reg[RCX] << offset << "]" << endl;
-  }
-  else
-    {
-     fatal("In store_float(): Invalid symbol tag or type, tag needs to be SYM_VAR and type real_type.");
-   }
+    if (r >= XMM0) {
+        out << "\t\t" << "sub" << "\t" << "rsp," << STACK_WIDTH << endl;
+        out << "\t\t" << "movsd" << "\t" << "qword ptr [rsp]," << reg[r]
+            << endl;
+    } else {
+        out << "\t\t" << "push" << "\t" << reg[r] << endl;
+    }
 }
 
 
-/* This function fetches the base address of an array. */
-void code_generator::array_address(sym_index sym_p, register_type dest)
+void code_generator::pop_register(register_type r)
 {
-    // we know that is a variable
-    int level, offset;
-    find(sym_p,&level, &offset);
-    frame_address(level, RCX);
-    out << "\t\t" << "sub" << "\t" << reg[RCX] << "," << -offset << endl;
-    out << "\t\t" << "mov" << "\t" << reg[dest] << "," << reg[RCX] << endl;
+    if (r >= XMM0) {
+        out << "\t\t" << "movsd" << "\t" << reg[r] << ",qword ptr [rsp]"
+            << endl;
+        out << "\t\t" << "add" << "\t" << "rsp," << STACK_WIDTH << endl;
+    } else {
+        out << "\t\t" << "pop" << "\t" << reg[r] << endl;
+    }
+}
+
+
+/* This function returns the condition code (as in jcc and setcc) under
+   which a relation holds, after comparing its arguments. ucomisd sets the
+   flags like an unsigned comparison, and unordered reals compare equal. */
+static string condition(quad_op_type op)
+{
+    switch (op) {
+    case q_ieq:
+    case q_req:
+        return "e";
+    case q_ine:
+    case q_rne:
+        return "ne";
+    case q_ilt:
+        return "l";
+    case q_igt:
+        return "g";
+    case q_rlt:
+        return "b";
+    case q_rgt:
+        return "a";
+    default:
+        fatal("condition() called for a non-relation");
+        return "";
+    }
+}
+
+
+/* This function returns the condition code under which a condition code
+   doesn't hold. */
+static string negated(const string &cc)
+{
+    if (cc == "e") return "ne";
+    if (cc == "ne") return "e";
+    if (cc == "l") return "ge";
+    if (cc == "g") return "le";
+    if (cc == "b") return "ae";
+    if (cc == "a") return "be";
+    fatal("negated() called for an unknown condition code");
+    return "";
+}
+
+
+/* This function returns true if the quads at a position of a quad list
+   are 'q_jmpf L1, x; q_jmp L2; q_labl L1', ie, a jump to L2 if x is true,
+   as generated for conditions. */
+static bool jumps_if_true(quad_list *q_list, long pos)
+{
+    if (pos + 2 >= q_list->size()) {
+        return false;
+    }
+    quadruple &jmpf = (*q_list)[pos];
+    quadruple &jmp = (*q_list)[pos + 1];
+    quadruple &labl = (*q_list)[pos + 2];
+    return jmpf.op_code == q_jmpf && jmp.op_code == q_jmp &&
+           labl.op_code == q_labl && labl.int1 == jmpf.int1;
+}
+
+
+/* This method makes a conditional jump, after the flags have been set, for
+   the q_jmpf at a position of a quad list. If it only jumps past a q_jmp,
+   the jump is made straight to the target of the q_jmp instead. Returns the
+   number of quads handled. Args: the quad list, the position, the condition
+   code for the value tested being true. */
+long code_generator::conditional_jump(quad_list *q_list, long pos,
+                                      const string &cc)
+{
+    if (jumps_if_true(q_list, pos)) {
+        out << "\t\t" << "j" << cc << "\t" << "L" << (*q_list)[pos + 1].int1
+            << endl;
+        return 2;
+    }
+    out << "\t\t" << "j" << negated(cc) << "\t" << "L" << (*q_list)[pos].int1
+        << endl;
+    return 1;
+}
+
+
+/* This method finishes a relation, whose arguments have just been compared.
+   If the relation is only used by a q_jmpf right after it, the jump is made
+   straight on the flags. Otherwise the result is stored as 0 or 1. Returns
+   the number of quads after the relation that were handled. Args: the quad
+   list, the position of the relation, the condition code for it holding. */
+long code_generator::relation_result(quad_list *q_list, long pos,
+                                     const string &cc)
+{
+    quadruple &q = (*q_list)[pos];
+    if (pos + 1 < q_list->size()) {
+        quadruple &next = (*q_list)[pos + 1];
+        if (next.op_code == q_jmpf && next.sym2 == q.sym3 &&
+            uses[q.sym3] == 1) {
+            return conditional_jump(q_list, pos + 1, cc);
+        }
+    }
+
+    out << "\t\t" << "set" << cc << "\t" << "al" << endl;
+    out << "\t\t" << "movzx" << "\t" << "eax, al" << endl;
+    store(RAX, q.sym3);
+    return 0;
 }
 
+
+/* This function finds the multiplier and shift with which a signed 64-bit
+   division by a constant of at least 3 is done: the quotient is the high
+   half of the product of the dividend and the multiplier (plus the dividend
+   if the multiplier is negative), shifted right, and plus one for negative
+   dividends. See Warren, Hacker's Delight, chapter 10. */
+static void magic_number(unsigned long d, long *multiplier, int *shift)
+{
+    const unsigned long two63 = 1UL << 63;
+    unsigned long anc = two63 - 1 - two63 % d;
+    unsigned long q1 = two63 / anc;
+    unsigned long r1 = two63 - q1 * anc;
+    unsigned long q2 = two63 / d;
+    unsigned long r2 = two63 - q2 * d;
+    unsigned long delta;
+    int p = 63;
+
+    // Find the smallest shift for which the multiplier is exact enough.
+    do {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= d) {
+            q2++;
+            r2 -= d;
+        }
+        delta = d - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    *multiplier = q2 + 1;
+    *shift = p - 64;
+}
+
+
+/* This function divides by an immediate other than 0 and -1 (which are left
+   to idiv, which traps like it should for them) without idiv, rounding
+   towards zero like idiv does, and returns the register holding the
+   quotient or, for a q_imod, the remainder. Powers of two are done with
+   shifts, after adding 2^k - 1 to negative dividends, and other divisors
+   by multiplying with a magic number. The remainder is the dividend minus
+   the quotient times the divisor, which has the dividend's sign. */
+register_type code_generator::divide_by_constant(quadruple *q)
+{
+    long d = q->int2;
+    unsigned long divisor = d < 0 ? - (unsigned long) d : d;
+    bool modulo = q->op_code == q_imod;
+    register_type src;
+
+    if (divisor == 1) {
+        if (modulo) {
+            out << "\t\t" << "xor" << "\t" << "eax, eax" << endl;
+            return RAX;
+        }
+        return operand(q->sym1, RAX);
+    }
+
+    if ((divisor & (divisor - 1)) == 0) {
+        int k = 0;
+        while ((1UL << k) != divisor) {
+            k++;
+        }
+        // rdx = 2^k - 1 if the dividend is negative, else 0
+        fetch(q->sym1, RAX);
+        out << "\t\t" << "mov" << "\t" << "rdx, rax" << endl;
+        if (k > 1) {
+            out << "\t\t" << "sar" << "\t" << "rdx, 63" << endl;
+        }
+        out << "\t\t" << "shr" << "\t" << "rdx, " << 64 - k << endl;
+        out << "\t\t" << "add" << "\t" << "rax, rdx" << endl;
+        if (modulo) {
+            out << "\t\t" << "and" << "\t" << "rax, " << divisor - 1
+                << endl;
+            out << "\t\t" << "sub" << "\t" << "rax, rdx" << endl;
+        } else {
+            out << "\t\t" << "sar" << "\t" << "rax, " << k << endl;
+            if (d < 0) {
+                out << "\t\t" << "neg" << "\t" << "rax" << endl;
+            }
+        }
+        return RAX;
+    }
+
+    long multiplier;
+    int shift;
+    magic_number(divisor, &multiplier, &shift);
+
+    // rdx = the quotient of the dividend and the divisor's absolute value
+    src = operand(q->sym1, RCX);
+    out << "\t\t" << "mov" << "\t" << "rax, " << multiplier << endl;
+    out << "\t\t" << "imul" << "\t" << reg[src] << endl;
+    if (multiplier < 0) {
+        out << "\t\t" << "add" << "\t" << "rdx, " << reg[src] << endl;
+    }
+    if (shift > 0) {
+        out << "\t\t" << "sar" << "\t" << "rdx, " << shift << endl;
+    }
+    out << "\t\t" << "mov" << "\t" << "rax, " << reg[src] << endl;
+    out << "\t\t" << "shr" << "\t" << "rax, 63" << endl;
+    out << "\t\t" << "add" << "\t" << "rdx, rax" << endl;
+
+    if (modulo) {
+        out << "\t\t" << "imul" << "\t" << "rdx, rdx, " << divisor << endl;
+        out << "\t\t" << "mov" << "\t" << "rax, " << reg[src] << endl;
+        out << "\t\t" << "sub" << "\t" << "rax, rdx" << endl;
+        return RAX;
+    }
+    if (d < 0) {
+        out << "\t\t" << "neg" << "\t" << "rdx" << endl;
+    }
+    return RDX;
+}
+
+
 /* This method expands a quad_list into assembler code, quad for quad. */
 void code_generator::expand(quad_list *q_list)
 {
     long quad_nr = 0;       // Just to make debug output easier to read.
+    register_type src;      // Register holding an operand.
+    string value;           // Immediate or register holding an operand.
+    long skip;              // Following quads handled along with this one.
     
 
     // We use this iterator to loop through the quad list.
-    quad_list_iterator *ql_iterator = new quad_list_iterator(q_list);
+    quad_list_iterator ql_iterator(q_list);
 
-    quadruple *q = ql_iterator->get_current(); // This is the head of the list.
+    quadruple *q = ql_iterator.get_current(); // This is the head of the list.
 
     while (q != NULL) {
         quad_nr++;
+        skip = 0;
 
         // We always do labels here so that a branch doesn't miss the
         // trace code.
@@ -301,32 +820,31 @@ void code_generator::expand(quad_list *q_list)
         switch (q->op_code) {
         case q_rload:
         case q_iload:
+            // Load integers straight into their register.
+            if (q->op_code == q_iload && register_of(q->sym3) != NO_REGISTER &&
+                register_of(q->sym3) < XMM0) {
+                out << "\t\t" << "mov" << "\t" << reg[register_of(q->sym3)]
+                    << ", " << q->int1 << endl;
+                break;
+            }
             out << "\t\t" << "mov" << "\t" << "rax, " << q->int1 << endl;
             store(RAX, q->sym3);
             break;
 
-        case q_inot: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
-
-            fetch(q->sym1, RAX);
-            out << "\t\t" << "cmp" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "je" << "\t" << "L" << label << endl;
-            // Not equal branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
-            // Equal branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
-
-            out << "\t\t" << "L" << label2 << ":" <<  endl;
+        case q_inot:
+            src = operand(q->sym1, RAX);
+            out << "\t\t" << "test" << "\t" << reg[src] << ", " << reg[src]
+                << endl;
+            out << "\t\t" << "sete" << "\t" << "al" << endl;
+            out << "\t\t" << "movzx" << "\t" << "eax, al" << endl;
             store(RAX, q->sym3);
             break;
-        }
+
         case q_ruminus:
-            fetch_float(q->sym1);
-            out << "\t\t" << "fchs" << endl;
-            store_float(q->sym3);
+            // flip the sign bit
+            fetch(q->sym1, RAX);
+            out << "\t\t" << "btc" << "\t" << "rax, 63" << endl;
+            store(RAX, q->sym3);
             break;
 
         case q_iuminus:
@@ -336,285 +854,153 @@ void code_generator::expand(quad_list *q_list)
             break;
 
         case q_rplus:
-            fetch_float(q->sym1);
-            fetch_float(q->sym2);
-            out << "\t\t" << "faddp" << endl;
-            store_float(q->sym3);
+            fetch_float(q->sym1, XMM0);
+            src = float_operand(q->sym2, XMM1);
+            out << "\t\t" << "addsd" << "\t" << "xmm0, " << reg[src] << endl;
+            store_float(XMM0, q->sym3);
             break;
 
         case q_iplus:
             fetch(q->sym1, RAX);
-            fetch(q->sym2, RCX);
-            out << "\t\t" << "add" << "\t" << "rax, rcx" << endl;
+            value = second_operand(q, RCX);
+            out << "\t\t" << "add" << "\t" << "rax, " << value << endl;
             store(RAX, q->sym3);
             break;
 
         case q_rminus:
-            fetch_float(q->sym1);
-            fetch_float(q->sym2);
-            out << "\t\t" << "fsubp" << endl;
-            store_float(q->sym3);
+            fetch_float(q->sym1, XMM0);
+            src = float_operand(q->sym2, XMM1);
+            out << "\t\t" << "subsd" << "\t" << "xmm0, " << reg[src] << endl;
+            store_float(XMM0, q->sym3);
             break;
 
         case q_iminus:
             fetch(q->sym1, RAX);
-            fetch(q->sym2, RCX);
-            out << "\t\t" << "sub" << "\t" << "rax, rcx" << endl;
+            value = second_operand(q, RCX);
+            out << "\t\t" << "sub" << "\t" << "rax, " << value << endl;
             store(RAX, q->sym3);
             break;
 
-        case q_ior: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
-
+        case q_ior:
+            // a or b is true if any bit of either is set
             fetch(q->sym1, RAX);
-            out << "\t\t" << "cmp" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jne" << "\t" << "L" << label << endl;
-            fetch(q->sym2, RAX);
-            out << "\t\t" << "cmp" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jne" << "\t" << "L" << label << endl;
-            // False branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
-            // True branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
-
-            out << "\t\t" << "L" << label2 << ":" << endl;
+            value = second_operand(q, RCX);
+            out << "\t\t" << "or" << "\t" << "rax, " << value << endl;
+            out << "\t\t" << "setne" << "\t" << "al" << endl;
+            out << "\t\t" << "movzx" << "\t" << "eax, al" << endl;
             store(RAX, q->sym3);
             break;
-        }
-        case q_iand: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
 
+        case q_iand:
             fetch(q->sym1, RAX);
-            out << "\t\t" << "cmp" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "je" << "\t" << "L" << label << endl;
-            fetch(q->sym2, RAX);
-            out << "\t\t" << "cmp" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "je" << "\t" << "L" << label << endl;
-            // True branch
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
-            // False branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-
-            out << "\t\t" << "L" << label2 << ":" << endl;
+            src = second_register(q, RCX);
+            out << "\t\t" << "test" << "\t" << "rax, rax" << endl;
+            out << "\t\t" << "setne" << "\t" << "al" << endl;
+            out << "\t\t" << "test" << "\t" << reg[src] << ", " << reg[src]
+                << endl;
+            out << "\t\t" << "setne" << "\t" << "cl" << endl;
+            out << "\t\t" << "and" << "\t" << "al, cl" << endl;
+            out << "\t\t" << "movzx" << "\t" << "eax, al" << endl;
             store(RAX, q->sym3);
             break;
-        }
+
         case q_rmult:
-            fetch_float(q->sym1);
-            fetch_float(q->sym2);
-            out << "\t\t" << "fmulp" << endl;
-            store_float(q->sym3);
+            fetch_float(q->sym1, XMM0);
+            src = float_operand(q->sym2, XMM1);
+            out << "\t\t" << "mulsd" << "\t" << "xmm0, " << reg[src] << endl;
+            store_float(XMM0, q->sym3);
             break;
 
         case q_imult:
             fetch(q->sym1, RAX);
-            fetch(q->sym2, RCX);
-            out << "\t\t" << "imul" << "\t" << "rax, rcx" << endl;
+            if (q->immediate && q->int2 > 0
+                && (q->int2 & (q->int2 - 1)) == 0) {
+                // multiplying by 2^k is a shift, by 2 an add
+                int k = 0;
+                while ((1L << k) != q->int2) {
+                    k++;
+                }
+                if (k == 1) {
+                    out << "\t\t" << "add" << "\t" << "rax, rax" << endl;
+                } else if (k > 1) {
+                    out << "\t\t" << "shl" << "\t" << "rax, " << k << endl;
+                }
+                store(RAX, q->sym3);
+                break;
+            }
+            value = second_operand(q, RCX);
+            out << "\t\t" << "imul" << "\t" << "rax, " << value << endl;
             store(RAX, q->sym3);
             break;
 
         case q_rdivide:
-            fetch_float(q->sym1);
-            fetch_float(q->sym2);
-            out << "\t\t" << "fdivp" << endl;
-            store_float(q->sym3);
+            fetch_float(q->sym1, XMM0);
+            src = float_operand(q->sym2, XMM1);
+            out << "\t\t" << "divsd" << "\t" << "xmm0, " << reg[src] << endl;
+            store_float(XMM0, q->sym3);
             break;
 
         case q_idivide:
+            if (q->immediate && q->int2 != 0 && q->int2 != -1) {
+                store(divide_by_constant(q), q->sym3);
+                break;
+            }
             fetch(q->sym1, RAX);
-            fetch(q->sym2, RCX);
+            src = second_register(q, RCX);
             out << "\t\t" << "cqo" << endl;
-            out << "\t\t" << "idiv" << "\t" << "rax, rcx" << endl;
+            out << "\t\t" << "idiv" << "\t" << reg[src] << endl;
             store(RAX, q->sym3);
             break;
 
         case q_imod:
+            if (q->immediate && q->int2 != 0 && q->int2 != -1) {
+                store(divide_by_constant(q), q->sym3);
+                break;
+            }
             fetch(q->sym1, RAX);
-            fetch(q->sym2, RCX);
+            src = second_register(q, RCX);
             out << "\t\t" << "cqo" << endl;
-            out << "\t\t" << "idiv" << "\t" << "rax, rcx" << endl;
+            out << "\t\t" << "idiv" << "\t" << reg[src] << endl;
             store(RDX, q->sym3);
             break;
 
-        case q_req: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
-
-            fetch_float(q->sym1);
-            fetch_float(q->sym2);
-            out << "\t\t" << "fcomip" << "\t" << "ST(0), ST(1)" << endl;
-            // Clear the stack
-            out << "\t\t" << "fstp" << "\t" << "ST(0)" << endl;
-            out << "\t\t" << "je" << "\t" << "L" << label << endl;
-            // False branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
-            // True branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
-
-            out << "\t\t" << "L" << label2 << ":" << endl;
-            store(RAX, q->sym3);
+        case q_ieq:
+        case q_ine:
+        case q_ilt:
+        case q_igt:
+            src = operand(q->sym1, RAX);
+            value = second_operand(q, RCX);
+            out << "\t\t" << "cmp" << "\t" << reg[src] << ", " << value
+                << endl;
+            skip = relation_result(q_list, quad_nr - 1,
+                                   condition(q->op_code));
             break;
-        }
-        case q_ieq: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
 
-            fetch(q->sym1, RAX);
-            fetch(q->sym2, RCX);
-            out << "\t\t" << "cmp" << "\t" << "rax, rcx" << endl;
-            out << "\t\t" << "je" << "\t" << "L" << label << endl;
-            // False branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
-            // True branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
-
-            out << "\t\t" << "L" << label2 << ":" << endl;
-            store(RAX, q->sym3);
-            break;
-        }
-        case q_rne: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
-
-            fetch_float(q->sym1);
-            fetch_float(q->sym2);
-            out << "\t\t" << "fcomip" << "\t" << "ST(0), ST(1)" << endl;
-            // Clear the stack
-            out << "\t\t" << "fstp" << "\t" << "ST(0)" << endl;
-            out << "\t\t" << "jne" << "\t" << "L" << label << endl;
-            // False branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
-            // True branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
-
-            out << "\t\t" << "L" << label2 << ":" << endl;
-            store(RAX, q->sym3);
-            break;
-        }
-        case q_ine: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
-
-            fetch(q->sym1, RAX);
-            fetch(q->sym2, RCX);
-            out << "\t\t" << "cmp" << "\t" << "rax, rcx" << endl;
-            out << "\t\t" << "jne" << "\t" << "L" << label << endl;
-            // False branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
-            // True branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
-
-            out << "\t\t" << "L" << label2 << ":" << endl;
-            store(RAX, q->sym3);
+        case q_req:
+        case q_rne:
+        case q_rlt:
+        case q_rgt:
+            fetch_float(q->sym1, XMM0);
+            src = float_operand(q->sym2, XMM1);
+            out << "\t\t" << "ucomisd" << "\t" << "xmm0, " << reg[src] << endl;
+            skip = relation_result(q_list, quad_nr - 1,
+                                   condition(q->op_code));
             break;
-        }
-        case q_rlt: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
-
-            // We need to push in reverse order for this to work
-            fetch_float(q->sym2);
-            fetch_float(q->sym1);
-            out << "\t\t" << "fcomip" << "\t" << "ST(0), ST(1)" << endl;
-            // Clear the stack
-            out << "\t\t" << "fstp" << "\t" << "ST(0)" << endl;
-            out << "\t\t" << "jb" << "\t" << "L" << label << endl;
-            // False branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
-            // True branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
-
-            out << "\t\t" << "L" << label2 << ":" << endl;
-            store(RAX, q->sym3);
-            break;
-        }
-        case q_ilt: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
 
-            fetch(q->sym1, RAX);
-            fetch(q->sym2, RCX);
-            out << "\t\t" << "cmp" << "\t" << "rax, rcx" << endl;
-            out << "\t\t" << "jl" << "\t" << "L" << label << endl;
-            // False branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
-            // True branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
-
-            out << "\t\t" << "L" << label2 << ":" << endl;
-            store(RAX, q->sym3);
-            break;
-        }
-        case q_rgt: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
-
-            // We need to push in reverse order for this to work
-            fetch_float(q->sym2);
-            fetch_float(q->sym1);
-            out << "\t\t" << "fcomip" << "\t" << "ST(0), ST(1)" << endl;
-            // Clear the stack
-            out << "\t\t" << "fstp" << "\t" << "ST(0)" << endl;
-            out << "\t\t" << "ja" << "\t" << "L" << label << endl;
-            // False branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
-            // True branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
-
-            out << "\t\t" << "L" << label2 << ":" << endl;
-            store(RAX, q->sym3);
-            break;
-        }
-        case q_igt: {
-            int label = sym_tab->get_next_label();
-            int label2 = sym_tab->get_next_label();
-
-            fetch(q->sym1, RAX);
-            fetch(q->sym2, RCX);
-            out << "\t\t" << "cmp" << "\t" << "rax, rcx" << endl;
-            out << "\t\t" << "jg" << "\t" << "L" << label << endl;
-            // False branch
-            out << "\t\t" << "mov" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "jmp" << "\t" << "L" << label2 << endl;
-            // True branch
-            out << "\t\t" << "L" << label << ":" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, 1" << endl;
-
-            out << "\t\t" << "L" << label2 << ":" << endl;
-            store(RAX, q->sym3);
-            break;
-        }
         case q_rstore:
         case q_istore:
             fetch(q->sym1, RAX);
-            fetch(q->sym3, RCX);
-            out << "\t\t" << "mov" << "\t" << "[rcx], rax" << endl;
+            src = operand(q->sym3, RCX);
+            out << "\t\t" << "mov" << "\t" << "[" << reg[src] << "], rax"
+                << endl;
             break;
 
         case q_rassign:
         case q_iassign:
-            fetch(q->sym1, RAX);
-            store(RAX, q->sym3);
+            src = operand(q->sym1, RAX);
+            if (src != register_of(q->sym3)) {
+                store(src, q->sym3);
+            }
             break;
 
         case q_param:
@@ -644,53 +1030,67 @@ void code_generator::expand(quad_list *q_list)
         }
         case q_rreturn:
         case q_ireturn:
-            fetch(q->sym2, RAX);
+            if (q->immediate) {
+                out << "\t\t" << "mov" << "\t" << "rax, " << q->int2 << endl;
+            } else {
+                fetch(q->sym2, RAX);
+            }
             out << "\t\t" << "jmp" << "\t" << "L" << q->int1 << endl;
             break;
 
-        case q_lindex:
-            array_address(q->sym1, RAX);
-            fetch(q->sym2, RCX);
-            out << "\t\t" << "imul" << "\t" << "rcx, " << STACK_WIDTH << endl;
-            out << "\t\t" << "sub" << "\t" << "rax, rcx" << endl;
+        case q_lindex: {
+            // A store through the address is done right here, into the
+            // element, if nothing else uses the address.
+            if (quad_nr < q_list->size() && uses[q->sym3] == 1 &&
+                ((*q_list)[quad_nr].op_code == q_istore ||
+                 (*q_list)[quad_nr].op_code == q_rstore) &&
+                (*q_list)[quad_nr].sym3 == q->sym3) {
+                src = operand((*q_list)[quad_nr].sym1, RAX);
+                string element = element_operand(q);
+                out << "\t\t" << "mov" << "\t" << element << ", "
+                    << reg[src] << endl;
+                skip = 1;
+                break;
+            }
+            string element = element_operand(q);
+            out << "\t\t" << "lea" << "\t" << "rax, " << element << endl;
             store(RAX, q->sym3);
             break;
+        }
 
         case q_rrindex:
-        case q_irindex:
-            array_address(q->sym1, RAX);
-            fetch(q->sym2, RCX);
-            out << "\t\t" << "imul" << "\t" << "rcx, " << STACK_WIDTH << endl;
-            out << "\t\t" << "sub" << "\t" << "rax, rcx" << endl;
-            out << "\t\t" << "mov" << "\t" << "rax, [rax]" << endl;
-            store(RAX, q->sym3);
-            break;
-
-        case q_itor: {
-            block_level level;      // Current scope level.
-            int offset;             // Offset within current activation record.
-
-            find(q->sym1, &level, &offset);
-            frame_address(level, RCX);
-            out << "\t\t" << "fild" << "\t" << "qword ptr [rcx";
-            if (offset >= 0) {
-                out << "+" << offset;
+        case q_irindex: {
+            // Load the element straight into the register of the result.
+            string element = element_operand(q);
+            int r = register_of(q->sym3);
+            if (r >= XMM0) {
+                out << "\t\t" << "movsd" << "\t" << reg[r] << ", qword ptr "
+                    << element << endl;
+            } else if (r != NO_REGISTER) {
+                out << "\t\t" << "mov" << "\t" << reg[r] << ", " << element
+                    << endl;
             } else {
-                out << offset; // Implicit "-"
+                out << "\t\t" << "mov" << "\t" << "rax, " << element << endl;
+                store(RAX, q->sym3);
             }
-            out << "]" << endl;
-            store_float(q->sym3);
+            break;
         }
-        break;
+
+        case q_itor:
+            src = operand(q->sym1, RAX);
+            out << "\t\t" << "cvtsi2sd" << "\t" << "xmm0, " << reg[src] << endl;
+            store_float(XMM0, q->sym3);
+            break;
 
         case q_jmp:
             out << "\t\t" << "jmp" << "\t" << "L" << q->int1 << endl;
             break;
 
         case q_jmpf:
-            fetch(q->sym2, RAX);
-            out << "\t\t" << "cmp" << "\t" << "rax, 0" << endl;
-            out << "\t\t" << "je" << "\t" << "L" << q->int1 << endl;
+            src = operand(q->sym2, RAX);
+            out << "\t\t" << "test" << "\t" << reg[src] << ", " << reg[src]
+                << endl;
+            skip = conditional_jump(q_list, quad_nr - 1, "ne") - 1;
             break;
 
         case q_labl:
@@ -703,8 +1103,12 @@ void code_generator::expand(quad_list *q_list)
             return;
         }
 
-        // Get the next quad from the list.
-        q = ql_iterator->get_next();
+        // Get the next quad from the list, passing those already handled.
+        for (; skip > 0; skip--) {
+            ql_iterator.get_next();
+            quad_nr++;
+        }
+        q = ql_iterator.get_next();
     }
 
     // Flush the generated code to file.
@@ -2,6 +2,8 @@
 #define __CODEGEN_HH__
 
 #include <fstream>
+#include <vector>
+#include <map>
 
 #include "quads.hh"
 #include "symtab.hh"
@@ -9,8 +11,46 @@
 using namespace std;
 
 
-/* These are the registers we will be using. */
-enum register_type { RAX, RCX, RDX };
+/* These are the registers we will be using. RAX, RCX and RDX, and XMM0 and
+   XMM1 for real values, are scratch registers for expanding single quads.
+   RBP points to the activation record of the current block. The others hold
+   temporaries and variables given registers by the quad optimizer, or the
+   address of an outer activation record (see DISPLAY_REGISTER), and every
+   procedure saves the ones it uses, so they survive calls. */
+enum register_type { RAX, RCX, RDX, RBX, RSI, RDI,
+                     R8, R9, R10, R11, R12, R13, R14, R15, RBP,
+                     XMM0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7,
+                     XMM8, XMM9, XMM10, XMM11, XMM12, XMM13, XMM14, XMM15 };
+
+const int REGISTER_COUNT = 31;
+
+// The registers the quad optimizer may hand out, in order of preference:
+// general purpose ones for integers, and XMM ones for reals. The last general
+// purpose one is only handed out in blocks that don't use the variables of
+// outer blocks, since it is the DISPLAY_REGISTER in those that do.
+const int ALLOCATABLE_REGISTERS = 11;
+const register_type allocatable[ALLOCATABLE_REGISTERS] =
+    { RBX, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+// The register holding the address of the outer activation record a block
+// uses the most, for the whole block, instead of it being loaded from the
+// display at every use.
+const register_type DISPLAY_REGISTER = R15;
+
+const int ALLOCATABLE_XMM_REGISTERS = 14;
+const register_type allocatable_xmm[ALLOCATABLE_XMM_REGISTERS] =
+    { XMM2, XMM3, XMM4, XMM5, XMM6, XMM7, XMM8,
+      XMM9, XMM10, XMM11, XMM12, XMM13, XMM14, XMM15 };
+
+
+// The level of the variables and arrays of the main program. These are kept
+// in static storage rather than in the main program's activation record,
+// since it is never entered twice. It is laid out like the record, downwards
+// from the label GLOBALS at its end, so arrays grow down just the same.
+const block_level GLOBAL_LEVEL = 1;
+
+// Return true if a symbol is kept in static storage. Defined in codegen.cc.
+bool is_static(const sym_index);
 
 
 // Maximum number of formal parameters allowed.
@@ -24,7 +64,25 @@ class code_generator
 {
 private:
     // Register array.
-    string reg[3];
+    string reg[REGISTER_COUNT];
+
+    // The registers used by the block code is being generated for, which
+    // the prologue saves and the epilogue restores.
+    vector<register_type> saved_registers;
+
+    // Distance from rbp down to the saved registers.
+    int saved_offset;
+
+    // The number of quads reading each value of the block.
+    map<sym_index, long> uses;
+
+    // The level of the variables of the block, and the level of the outer
+    // block whose activation record DISPLAY_REGISTER points to, or -1.
+    int current_level;
+    int display_level;
+
+    // The size of the static storage used so far.
+    int static_size;
 
     // Output file stream.
     ofstream out;
@@ -41,26 +99,61 @@ private:
     // Quadlist -> assembler.
     void expand(quad_list *q);
 
+    // Divide by an immediate without idiv. Returns the register holding the
+    // result.
+    register_type divide_by_constant(quadruple *);
+
+    // Jump on or store the outcome of a comparison.
+    long relation_result(quad_list *, long, const string &);
+
+    // Jump on the flags for a q_jmpf.
+    long conditional_jump(quad_list *, long, const string &);
+
     // Get variable/parameter level & offset.
     void find(sym_index, int *, int *);
 
+    // Get the memory operand addressing a variable, parameter or array
+    // base, using the given register for the frame address if need be.
+    string memory_operand(sym_index, const register_type);
+
+    // Get the memory operand addressing the array element a quad indexes.
+    string element_operand(quadruple *);
+
+    // Get the register of a variable or temporary, or NO_REGISTER.
+    int register_of(sym_index);
+
+    // The register holding a value: its own one, or else the given one,
+    // after fetching the value into it.
+    register_type operand(sym_index, const register_type);
+
     // memory -> register.
     void fetch(sym_index, const register_type);
 
-    // memory -> FPU.
-    void fetch_float(sym_index);
+    // memory -> XMM register.
+    void fetch_float(sym_index, const register_type);
+
+    // The XMM register holding a real value: its own one, or else the given
+    // one, after fetching the value into it.
+    register_type float_operand(sym_index, const register_type);
+
+    // The second argument of a quad, as an immediate or a register, or
+    // always as a register.
+    string second_operand(quadruple *, const register_type);
+    register_type second_register(quadruple *, const register_type);
 
     // register -> memory.
     void store(const register_type, sym_index);
 
-    // FPU -> memory.
-    void store_float(sym_index);
+    // XMM register -> memory.
+    void store_float(const register_type, sym_index);
 
-    // Get array base address.
-    void array_address(sym_index, const register_type);
+    // Save a register on the stack / restore it from there.
+    void push_register(const register_type);
+    void pop_register(const register_type);
 
-    // Get frame base address.
-    void frame_address(int level, const register_type);
+    // Get frame base address. Returns the register holding it: rbp,
+    // DISPLAY_REGISTER or the given register, after loading it.
+    register_type frame_address(int level, const register_type);
 public:
     // Constructor. Arg = filename of assembler outfile.
     code_generator(const string);
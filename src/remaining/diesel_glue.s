@@ -13,17 +13,6 @@
 
 main: # this is where the process starts
 
-    # As we only use truncation and no other rounding
-    # we just set the rounding mode to truncate here.
-    # We need to keep the previous control word so we have
-    # to or in the new data we want. Note that the constant
-    # sets the two bits that we want so or is enough.
-    enter 8, 0
-    fnstcw word ptr [rbp-8]
-    or word ptr [rbp-8], 3072 # from FE_TOWARDZERO
-    fldcw word ptr [rbp-8]
-    leave
-
     enter 0, 0
     call    L3        # L3 is the DIESEL main program label
     leave
@@ -31,23 +20,53 @@ main: # this is where the process starts
     mov rax, 0
     ret
 
+# DIESEL code expects every register but RAX, RCX, RDX, XMM0 and XMM1 to
+# survive a call, while GCC-compiled functions may change RSI, RDI, R8-R11
+# and all XMM registers too. The wrappers below save those around the calls
+# (SAVE_REGISTERS and RESTORE_REGISTERS), keeping the stack alignment.
+
+.macro SAVE_REGISTERS
+    push rsi
+    push rdi
+    push r8
+    push r9
+    push r10
+    push r11
+    sub rsp, 112
+    .irp n, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+    movsd qword ptr [rsp+8*(\n-2)], xmm\n
+    .endr
+.endm
+
+.macro RESTORE_REGISTERS
+    .irp n, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+    movsd xmm\n, qword ptr [rsp+8*(\n-2)]
+    .endr
+    add rsp, 112
+    pop r11
+    pop r10
+    pop r9
+    pop r8
+    pop rdi
+    pop rsi
+.endm
+
 L0: # read function
     # Return value is in RAX
+    SAVE_REGISTERS
     call    getchar
+    RESTORE_REGISTERS
     ret
 
 L1: # write procedure
-    mov rdi, qword ptr [rsp+8]
+    SAVE_REGISTERS
+    mov rdi, qword ptr [rsp+168]
     call    myputchar    # in diesel_rts.o
+    RESTORE_REGISTERS
     ret
 
 L2: # trunc function
     # This very cryptic instruction
     # ConVerTs with Truncation a Signed Double TO a Signed Integer
-    # cvttsd2si rax, [rsp+8]
-    enter 8, 0
-    fld qword ptr [rbp+16]
-    fistp qword ptr [rbp-8]
-    mov rax, qword ptr [rbp-8]
-    leave
+    cvttsd2si rax, qword ptr [rsp+8]
     ret
@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/resource.h>
 
 #include "ast.hh"
 #include "parser.hh"
@@ -14,15 +15,18 @@ extern bool yydebug;
 bool assembler_trace = false;
 bool print_ast = false;
 bool print_quads = false;
+bool print_cfg = false;
 bool typecheck = true;
 bool optimize = true;
 bool quads = true;
 bool assembler = true;
+bool release_scopes = false;
+bool verbose = false;
 
 void usage(char *program_name)
 {
     cerr << "Usage:\n"
-         << program_name << " [-acdfpqsty] inputfile\n"
+         << program_name << " [-acdfgmpqrstvy] inputfile\n"
          << program_name << " [-h?]\n"
          << "Options:\n"
          << "  -h, -?            Shows this message.\n"
@@ -30,10 +34,14 @@ void usage(char *program_name)
          << "  -c                Disable type checking.\n"
          << "  -d                Turn on parser debugging.\n"
          << "  -f                Don't optimize.\n"
+         << "  -g                Print control flow graphs.\n"
+         << "  -m                Print peak memory usage.\n"
          << "  -p                Don't generate quads.\n"
          << "  -q                Print quad lists.\n"
+         << "  -r                Release the symbols of finished blocks.\n"
          << "  -s                Don't generate assembler code.\n"
          << "  -t                Include trace printouts in assembler code.\n"
+         << "  -v                Report what the optimizer did.\n"
          << "  -y                Print symbol table.\n";
     exit(1);
 }
@@ -41,9 +49,10 @@ void usage(char *program_name)
 
 int main(int argc, char **argv)
 {
-    char options[] = "acdfpqstyh?";
+    char options[] = "acdfgmpqrstvyh?";
     int option;
     bool print_symtab = false;
+    bool print_memory = false;
 
     extern  FILE *yyin;
 
@@ -69,6 +78,16 @@ int main(int argc, char **argv)
             cout << "No optimization will be done.\n" << flush;
             optimize = false;
             break;
+        case 'g':
+            cout << "A control flow graph will be printed for each block.\n"
+                 << flush;
+            print_cfg = true;
+            break;
+        case 'm':
+            cout << "Peak memory usage will be printed after compilation.\n"
+                 << flush;
+            print_memory = true;
+            break;
         case 'p':
             cout << "No quads will be generated.\n" << flush;
             quads = false;
@@ -78,6 +97,11 @@ int main(int argc, char **argv)
                  << flush;
             print_quads = true;
             break;
+        case 'r':
+            cout << "Symbols of finished blocks will be released.\n"
+                 << flush;
+            release_scopes = true;
+            break;
         case 's':
             cout << "No assembler code will be generated.\n" << flush;
             assembler = false;
@@ -86,6 +110,10 @@ int main(int argc, char **argv)
             cout << "Assembler code will contain quad labels.\n" << flush;
             assembler_trace = true;
             break;
+        case 'v':
+            cout << "The optimizer will report what it did.\n" << flush;
+            verbose = true;
+            break;
         case 'y':
             cout << "Symbol table will be printed after compilation.\n";
             print_symtab = true;
@@ -123,6 +151,14 @@ int main(int argc, char **argv)
         sym_tab->print(1);
     }
 
+    // Report the peak resident set size, which is what -r is meant to
+    // bring down for large programs.
+    if (print_memory) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        cout << "Peak resident set size: " << usage.ru_maxrss << " kB\n";
+    }
+
     exit(error_count);
 }
 
@@ -1,14 +1,20 @@
+#include <cmath>
 #include "optimize.hh"
 
 /*** This file contains all code pertaining to AST optimisation. It currently
      implements a simple optimisation called "constant folding". Most of the
      methods in this file are empty, or just relay optimize calls downward
      in the AST. If a more powerful AST optimization scheme were to be
-     implemented, only methods in this file should need to be changed. ***/
+     implemented, only methods in this file should need to be changed.
+     Operations that can't be folded are passed on to simplify(), which
+     applies algebraic identities and reassociates integer constants. ***/
 
 
 ast_optimizer *optimizer = new ast_optimizer();
 
+// Defined in main.cc.
+extern bool verbose;
+
 
 /* The optimizer's interface method. Starts a recursive optimize call down
    the AST nodes, searching for binary operators with constant children. */
@@ -176,8 +182,8 @@ ast_expression *ast_optimizer::fold_constants(ast_expression *node)
                                                             left_int->value,
                                                             right_int->value));
                 }else
-                    // could not optimize
-                    return node;
+                    // could not fold
+                    return simplify(node);
             }else
             if(binop->type == real_type){
                 ast_real *left_real  = binop->left->get_ast_real();
@@ -187,8 +193,8 @@ ast_expression *ast_optimizer::fold_constants(ast_expression *node)
                                                             left_real->value,
                                                             right_real->value));
                 }else
-                    // could not optimize
-                    return node;
+                    // could not fold
+                    return simplify(node);
             }else
                 fatal("strange binary operation type");
                 return NULL;
@@ -233,8 +239,8 @@ ast_expression *ast_optimizer::fold_constants(ast_expression *node)
                     return new ast_integer(node->pos, unop->calculate_int(
                                                             expr_int->value));
                 }else
-                    // could not optimize
-                    return node;
+                    // could not fold
+                    return simplify(node);
             }else
             if(unop->type == real_type){
                 ast_real *expr_real = unop->expr->get_ast_real();
@@ -258,6 +264,344 @@ ast_expression *ast_optimizer::fold_constants(ast_expression *node)
     return NULL;
 }
 
+/* Tells the user about a rewrite done by simplify(), if running verbose. */
+static void report(ast_expression *node, const char *rewrite)
+{
+    if (verbose) {
+        cout << "Simplified " << rewrite << " at line "
+             << node->pos->get_line() << endl;
+    }
+}
+
+/* Returns true if evaluating the expression has no side effects, that is if
+   it calls no functions and divides by nothing that might be zero. Only
+   such expressions may be dropped. */
+static bool is_pure(ast_expression *node)
+{
+    switch(node->tag){
+        case AST_ID:
+        case AST_INTEGER:
+        case AST_REAL:
+            return true;
+        case AST_INDEXED:
+            return is_pure(node->get_ast_indexed()->index);
+        case AST_CAST:
+            return is_pure(node->get_ast_cast()->expr);
+        case AST_UMINUS:
+        case AST_NOT:
+            return is_pure(node->get_ast_unaryoperation()->expr);
+        case AST_EQUAL:
+        case AST_NOTEQUAL:
+        case AST_LESSTHAN:
+        case AST_GREATERTHAN: {
+            ast_binaryrelation *binrel = node->get_ast_binaryrelation();
+            return is_pure(binrel->left) && is_pure(binrel->right);
+        }
+        case AST_IDIV:
+        case AST_MOD: {
+            // dividing by zero traps, so keep divisions unless the divisor
+            // is known
+            ast_binaryoperation *binop = node->get_ast_binaryoperation();
+            ast_integer *right_int = binop->right->get_ast_integer();
+            return right_int != NULL && right_int->value != 0 &&
+                   is_pure(binop->left);
+        }
+        case AST_DIVIDE: {
+            ast_binaryoperation *binop = node->get_ast_binaryoperation();
+            if(binop->type != real_type)
+                return false;
+            return is_pure(binop->left) && is_pure(binop->right);
+        }
+        case AST_ADD:
+        case AST_SUB:
+        case AST_MULT:
+        case AST_OR:
+        case AST_AND: {
+            ast_binaryoperation *binop = node->get_ast_binaryoperation();
+            return is_pure(binop->left) && is_pure(binop->right);
+        }
+        default:
+            return false;
+    }
+}
+
+/* Returns true if an operand can replace the operation it belongs to. The
+   quads for an operation read a variable operand only when the operation
+   is done, which is after the other operand of the enclosing operation has
+   been evaluated. If that operand calls a function changing the variable,
+   the value read would differ, so bare variables must stay inside their
+   operation, which reads them at the right time. */
+static bool can_replace(ast_expression *operand)
+{
+    return operand->tag != AST_ID && operand->tag != AST_INDEXED;
+}
+
+/* Returns true if the two expressions are written the same way. Real
+   constants are never considered the same, since x - x isn't 0 for reals. */
+static bool same_expression(ast_expression *a, ast_expression *b)
+{
+    if(a->tag != b->tag)
+        return false;
+    switch(a->tag){
+        case AST_ID:
+            return a->get_ast_id()->sym_p == b->get_ast_id()->sym_p;
+        case AST_INTEGER:
+            return a->get_ast_integer()->value == b->get_ast_integer()->value;
+        case AST_INDEXED:
+            return a->get_ast_indexed()->id->sym_p ==
+                   b->get_ast_indexed()->id->sym_p &&
+                   same_expression(a->get_ast_indexed()->index,
+                                   b->get_ast_indexed()->index);
+        case AST_CAST:
+            return same_expression(a->get_ast_cast()->expr,
+                                   b->get_ast_cast()->expr);
+        case AST_UMINUS:
+        case AST_NOT:
+            return same_expression(a->get_ast_unaryoperation()->expr,
+                                   b->get_ast_unaryoperation()->expr);
+        case AST_EQUAL:
+        case AST_NOTEQUAL:
+        case AST_LESSTHAN:
+        case AST_GREATERTHAN:
+            return same_expression(a->get_ast_binaryrelation()->left,
+                                   b->get_ast_binaryrelation()->left) &&
+                   same_expression(a->get_ast_binaryrelation()->right,
+                                   b->get_ast_binaryrelation()->right);
+        case AST_ADD:
+        case AST_SUB:
+        case AST_MULT:
+        case AST_DIVIDE:
+        case AST_OR:
+        case AST_AND:
+        case AST_IDIV:
+        case AST_MOD:
+            return same_expression(a->get_ast_binaryoperation()->left,
+                                   b->get_ast_binaryoperation()->left) &&
+                   same_expression(a->get_ast_binaryoperation()->right,
+                                   b->get_ast_binaryoperation()->right);
+        default:
+            return false;
+    }
+}
+
+/* Returns true if the expression can only be 0 or 1. */
+static bool is_boolean(ast_expression *node)
+{
+    switch(node->tag){
+        case AST_EQUAL:
+        case AST_NOTEQUAL:
+        case AST_LESSTHAN:
+        case AST_GREATERTHAN:
+        case AST_AND:
+        case AST_OR:
+        case AST_NOT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* If the node is x + c or x - c for an integer constant c, sets base to x
+   and offset to c or -c, and returns true. The offset is unsigned so that
+   adding offsets wraps around like the generated code does. */
+static bool split_offset(ast_expression *node,
+                         ast_expression **base,
+                         unsigned long *offset)
+{
+    if(node->tag != AST_ADD && node->tag != AST_SUB)
+        return false;
+    ast_binaryoperation *binop = node->get_ast_binaryoperation();
+    ast_integer *right_int = binop->right->get_ast_integer();
+    if(binop->type != integer_type || right_int == NULL)
+        return false;
+    *base = binop->left;
+    *offset = right_int->value;
+    if(node->tag == AST_SUB)
+        *offset = - *offset;
+    return true;
+}
+
+/* Simplifies an integer operation. Constants are kept to the right of + and
+   *, so that (x + c1) + c2 and (x * c1) * c2 can be combined into one
+   operation. Multiplications by powers of two are left for the code
+   generator, which turns them into shifts. */
+static ast_expression *simplify_integer(ast_binaryoperation *binop)
+{
+    position_information *pos = binop->pos;
+
+    if((binop->tag == AST_ADD || binop->tag == AST_MULT) &&
+       binop->left->get_ast_integer() != NULL){
+        ast_expression *constant = binop->left;
+        binop->left = binop->right;
+        binop->right = constant;
+    }
+
+    ast_expression *left = binop->left;
+    ast_integer *right_int = binop->right->get_ast_integer();
+    if(right_int == NULL){
+        if(binop->tag == AST_SUB && is_pure(left) &&
+           same_expression(left, binop->right)){
+            report(binop, "x - x to 0");
+            return new ast_integer(pos, 0);
+        }
+        return binop;
+    }
+
+    long value = right_int->value;
+    ast_expression *base;
+    unsigned long offset;
+    switch(binop->tag){
+        case AST_ADD:
+        case AST_SUB:
+            if(value == 0 && can_replace(left)){
+                report(binop, binop->tag == AST_ADD ? "x + 0 to x"
+                                                    : "x - 0 to x");
+                return left;
+            }
+            if(split_offset(left, &base, &offset)){
+                if(binop->tag == AST_ADD)
+                    offset += value;
+                else
+                    offset -= value;
+                if(offset == 0 && !can_replace(base))
+                    return binop;
+                report(binop, "(x + c1) + c2 to x + c");
+                if(offset == 0)
+                    return base;
+                ast_integer *sum_int = new ast_integer(pos, (long) offset);
+                ast_add *sum = new ast_add(pos, base, sum_int);
+                sum->type = integer_type;
+                return sum;
+            }
+            return binop;
+        case AST_MULT:
+            if(value == 1 && can_replace(left)){
+                report(binop, "x * 1 to x");
+                return left;
+            }
+            if(value == 0 && is_pure(left)){
+                report(binop, "x * 0 to 0");
+                return new ast_integer(pos, 0);
+            }
+            if(left->tag == AST_MULT){
+                ast_binaryoperation *inner = left->get_ast_binaryoperation();
+                ast_integer *inner_int = inner->right->get_ast_integer();
+                if(inner_int != NULL){
+                    report(binop, "(x * c1) * c2 to x * c");
+                    unsigned long product = inner_int->value;
+                    product *= value;
+                    ast_integer *product_int = new ast_integer(pos,
+                                                               (long) product);
+                    ast_mult *mult = new ast_mult(pos, inner->left,
+                                                  product_int);
+                    mult->type = integer_type;
+                    return simplify_integer(mult);
+                }
+            }
+            return binop;
+        case AST_IDIV:
+            if(value == 1 && can_replace(left)){
+                report(binop, "x div 1 to x");
+                return left;
+            }
+            return binop;
+        case AST_MOD:
+            if(value == 1 && is_pure(left)){
+                report(binop, "x mod 1 to 0");
+                return new ast_integer(pos, 0);
+            }
+            return binop;
+        default:
+            return binop;
+    }
+}
+
+/* Simplifies a real operation. Only rewrites giving exactly the same result
+   are done, so x + 0.0 (which is wrong for x = -0.0) and reassociation are
+   left alone. Dividing by a power of two is exact, as is multiplying by its
+   reciprocal, as long as the reciprocal isn't denormal. */
+static ast_expression *simplify_real(ast_binaryoperation *binop)
+{
+    position_information *pos = binop->pos;
+
+    if(binop->tag == AST_MULT && binop->left->get_ast_real() != NULL){
+        ast_expression *constant = binop->left;
+        binop->left = binop->right;
+        binop->right = constant;
+    }
+
+    ast_real *right_real = binop->right->get_ast_real();
+    if(right_real == NULL)
+        return binop;
+
+    double value = right_real->value;
+    switch(binop->tag){
+        case AST_MULT:
+            if(value == 1.0 && can_replace(binop->left)){
+                report(binop, "x * 1.0 to x");
+                return binop->left;
+            }
+            return binop;
+        case AST_DIVIDE: {
+            if(value == 1.0 && can_replace(binop->left)){
+                report(binop, "x / 1.0 to x");
+                return binop->left;
+            }
+            int exponent;
+            double reciprocal = 1.0 / value;
+            if(fabs(frexp(value, &exponent)) == 0.5 &&
+               std::isnormal(reciprocal)){
+                report(binop, "x / 2^k to x * 2^-k");
+                ast_mult *mult = new ast_mult(pos, binop->left,
+                                              new ast_real(pos, reciprocal));
+                mult->type = real_type;
+                return mult;
+            }
+            return binop;
+        }
+        default:
+            return binop;
+    }
+}
+
+/* Applies algebraic identities to an operation that fold_constants()
+   couldn't evaluate. The operands have already been folded and simplified
+   themselves. */
+ast_expression *ast_optimizer::simplify(ast_expression *node)
+{
+    switch(node->tag){
+        case AST_NOT: {
+            ast_unaryoperation *unop = node->get_ast_unaryoperation();
+            if(unop->expr->tag != AST_NOT)
+                return node;
+            ast_expression *expr = unop->expr->get_ast_unaryoperation()->expr;
+            if(is_boolean(expr)){
+                report(node, "not not x to x");
+                return expr;
+            }
+            // still needs to turn any non-zero value into 1
+            report(node, "not not x to x <> 0");
+            return new ast_notequal(node->pos, expr,
+                                    new ast_integer(node->pos, 0));
+        }
+        case AST_ADD:
+        case AST_SUB:
+        case AST_MULT:
+        case AST_DIVIDE:
+        case AST_IDIV:
+        case AST_MOD: {
+            ast_binaryoperation *binop = node->get_ast_binaryoperation();
+            if(binop->type == integer_type)
+                return simplify_integer(binop);
+            if(binop->type == real_type)
+                return simplify_real(binop);
+            return node;
+        }
+        default:
+            return node;
+    }
+}
+
 /* All the binary operations should already have been detected in their parent
    nodes, so we don't need to do anything at all here. */
 void ast_binaryoperation::optimize()
@@ -397,6 +741,8 @@ void ast_procedurecall::optimize()
 
 void ast_assign::optimize()
 {
+    // an array element's index can be folded too
+    lhs->optimize();
     rhs = optimizer->fold_constants(rhs);
 }
 
@@ -9,7 +9,10 @@
      tries to evaluate a binary operation node such as 2 + 5 during compiling,
      replacing it with a single integer node with value 7, or an expression
      only involving constants, such as (assuming FOO = 2) 4 + FOO, replacing
-     the + node with an integer node with the value 6. ***/
+     the + node with an integer node with the value 6. Nodes that can't be
+     folded are then simplified using algebraic identities such as x + 0 = x
+     and x - x = 0, and constants are reassociated, so i + 1 + 1 becomes
+     i + 2. ***/
 
 
 class ast_optimizer;
@@ -37,6 +40,11 @@ public:
     // so the ast_* nodes can access it. Another solution would be to make it
     // a static method in the optimize.cc file... A matter of preference.
     ast_expression *fold_constants(ast_expression *);
+
+    // Rewrites an operation node whose operands are already folded, but not
+    // all constant, into a cheaper equivalent one. Returns the new node, or
+    // the argument if no identity applies.
+    ast_expression *simplify(ast_expression *);
 };
 
 
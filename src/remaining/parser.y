@@ -3,6 +3,8 @@
 #include "semantic.hh"
 #include "optimize.hh"
 #include "codegen.hh"
+#include "cfg.hh"
+#include "quadopt.hh"
 
 /* Defined in parser.cc */
 extern char *yytext;
@@ -30,10 +32,17 @@ extern void yyerror(string);
    given to the 'diesel' script. */
 extern bool print_ast;
 extern bool print_quads;
+extern bool print_cfg;
 extern bool typecheck;
 extern bool optimize;
 extern bool quads;
 extern bool assembler;
+extern bool release_scopes;
+
+/* The arena position at the start of each block, indexed by the level of
+   the procedure or function symbol. The AST of a block is released back to
+   this mark once the block has been compiled. */
+static arena_mark block_marks[MAX_BLOCK + 1];
 
 #define YYDEBUG 1
 
@@ -148,16 +157,27 @@ program         : prog_decl subprog_part comp_stmt T_DOT
                     if (error_count == 0) {
                         if (quads) {
                             quad_list *q = $1->do_quads($3);
+                            if (optimize) {
+                                q = quad_opt->do_optimize(q, env);
+                            }
                             if (print_quads) {
                                 cout << "\nQuad list for global level" << endl;
                                 cout << (quad_list *)q << endl;
                             }
 
+                            if (print_cfg) {
+                                control_flow_graph cfg(q);
+                                cout << "\nControl flow graph for global level"
+                                     << endl;
+                                cout << &cfg << endl;
+                            }
+
                             if (assembler) {
                                 cout << "Generating assembler, global level"
                                      << endl;
                                 code_gen->generate_assembler(q, env);
                             }
+                            delete q;
                         }
                     } else {
                         cout << "Found " << error_count << " errors. "
@@ -180,8 +200,8 @@ prog_decl       : prog_head T_SEMICOLON const_part variable_part
 prog_head       : T_PROGRAM T_IDENT
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
 
                     sym_index prog_index = sym_tab->enter_procedure(pos, $2);
 
@@ -206,7 +226,7 @@ const_decls     : const_decl
 
 const_decl      : T_IDENT T_EQ integer T_SEMICOLON
                 {
-                    position_information *this_pos = new position_information(
+                    position_information *this_pos = new (ast_arena) position_information(
                                                          @1.first_line, 
                                                          @1.first_column);
                     sym_index dex = sym_tab->enter_constant(this_pos,
@@ -218,7 +238,7 @@ const_decl      : T_IDENT T_EQ integer T_SEMICOLON
                 }
                 | T_IDENT T_EQ real T_SEMICOLON
                 {
-                    position_information *this_pos = new position_information(
+                    position_information *this_pos = new (ast_arena) position_information(
                                                          @1.first_line, 
                                                          @1.first_column);
                     sym_index dex = sym_tab->enter_constant(this_pos,
@@ -238,13 +258,16 @@ const_decl      : T_IDENT T_EQ integer T_SEMICOLON
                     // constant foo = 5;
                     // constant bar = foo;
                     // ...now, why would anyone want to do that?
-                    position_information *this_pos = new position_information(
+                    position_information *this_pos = new (ast_arena) position_information(
                                                          @1.first_line, 
                                                          @1.first_column);
 
                     sym_index const_index = $3->sym_p;
-                    constant_symbol *const_symbol = dynamic_cast<constant_symbol*>
-                        (sym_tab->get_symbol(const_index));
+                    symbol *sym = sym_tab->get_symbol(const_index);
+                    constant_symbol *const_symbol = nullptr;
+                    if (sym != nullptr && sym->kind == SYM_CONST) {
+                        const_symbol = sym->get_constant_symbol();
+                    }
                     if (const_symbol == nullptr ) {
                       type_error(this_pos) << ErrorMap[SYMBOL_CAST]
                                            << yytext << endl << flush;
@@ -287,7 +310,7 @@ var_decls       : var_decl
 var_decl        : T_IDENT T_COLON type_id T_SEMICOLON
                 {
                     // normal variable
-                    position_information *pos = new position_information(
+                    position_information *pos = new (ast_arena) position_information(
                                     @1.first_line, 
                                     @1.first_column);
                     sym_index dex = sym_tab->enter_variable(pos,
@@ -297,7 +320,7 @@ var_decl        : T_IDENT T_COLON type_id T_SEMICOLON
                 | T_IDENT T_COLON T_ARRAY T_LEFTBRACKET integer T_RIGHTBRACKET T_OF type_id T_SEMICOLON
                 {
                     /* Array declaration */
-                    position_information *var_decl_pos = new position_information(
+                    position_information *var_decl_pos = new (ast_arena) position_information(
                                     @1.first_line, 
                                     @1.first_column);
                     sym_index dex = sym_tab->enter_array(var_decl_pos,
@@ -311,8 +334,8 @@ var_decl        : T_IDENT T_COLON type_id T_SEMICOLON
                     // the id type of the constant, and the value of the
                     // constant.
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
 
                     // Ideally we should be able to just enter the array and
                     // defer index type checking to the semantic phase.
@@ -378,7 +401,7 @@ subprog_decl    : proc_decl subprog_part comp_stmt T_SEMICOLON
 
                     if (print_ast) {
                         cout << "\nUnoptimized AST for \""
-                             << sym_tab->pool_lookup(env->id)
+                             << sym_tab->pool_view(env->id)
                              << "\"" << endl;
                         cout << (ast_stmt_list *)$3 << endl;
                     }
@@ -387,7 +410,7 @@ subprog_decl    : proc_decl subprog_part comp_stmt T_SEMICOLON
                         optimizer->do_optimize($3);
                         if (print_ast) {
                             cout << "\nOptimized AST for \""
-                                 << sym_tab->pool_lookup(env->id)
+                                 << sym_tab->pool_view(env->id)
                                  << "\"" << endl;
                             cout << (ast_stmt_list*)$3 << endl;
                         }
@@ -396,24 +419,47 @@ subprog_decl    : proc_decl subprog_part comp_stmt T_SEMICOLON
                     if (error_count == 0) {
                         if (quads) {
                             quad_list *q = $1->do_quads($3);
+                            if (optimize) {
+                                q = quad_opt->do_optimize(q, env);
+                            }
                             if (print_quads) {
                                 cout << "\nQuad list for \""
-                                     << sym_tab->pool_lookup(env->id)
+                                     << sym_tab->pool_view(env->id)
                                      << "\"" << endl;
                                 cout << (quad_list *)q << endl;
                             }
 
+                            if (print_cfg) {
+                                control_flow_graph cfg(q);
+                                cout << "\nControl flow graph for \""
+                                     << sym_tab->pool_view(env->id)
+                                     << "\"" << endl;
+                                cout << &cfg << endl;
+                            }
+
                             if (assembler) {
                                 cout << "Generating assembler for procedure \""
-                                     << sym_tab->pool_lookup(env->id)
+                                     << sym_tab->pool_view(env->id)
                                      << "\"" << endl;
                                 code_gen->generate_assembler(q, env);
                             }
+                            delete q;
                         }
                     }
 
                     // Close the current scope.
                     sym_tab->close_scope();
+
+                    // The code for the block has been emitted, so all but
+                    // its head can be thrown away. The next token is a
+                    // keyword, so no string the scanner has handed out is
+                    // lost with the scope.
+                    if (release_scopes) {
+                        sym_tab->release_scope($1->sym_p);
+                    }
+                
+                    // Nothing refers to the AST of the block any longer.
+                    ast_arena.release(block_marks[env->level]);
                 }
                 | func_decl subprog_part comp_stmt T_SEMICOLON
                 {
@@ -426,7 +472,7 @@ subprog_decl    : proc_decl subprog_part comp_stmt T_SEMICOLON
 
                     if (print_ast) {
                         cout << "\nUnoptimized AST for \""
-                             << sym_tab->pool_lookup(env->id)
+                             << sym_tab->pool_view(env->id)
                              << "\"" << endl;
                         cout << (ast_stmt_list *)$3 << endl;
                     }
@@ -435,7 +481,7 @@ subprog_decl    : proc_decl subprog_part comp_stmt T_SEMICOLON
                         optimizer->do_optimize($3);
                         if (print_ast) {
                             cout << "\nOptimized AST for \""
-                                 << sym_tab->pool_lookup(env->id)
+                                 << sym_tab->pool_view(env->id)
                                  << "\"" << endl;
                             cout << (ast_stmt_list *)$3 << endl;
                         }
@@ -444,24 +490,47 @@ subprog_decl    : proc_decl subprog_part comp_stmt T_SEMICOLON
                     if (error_count == 0) {
                         if (quads) {
                             quad_list *q = $1->do_quads($3);
+                            if (optimize) {
+                                q = quad_opt->do_optimize(q, env);
+                            }
                             if (print_quads) {
                                 cout << "\nQuad list for \""
-                                     << sym_tab->pool_lookup(env->id)
+                                     << sym_tab->pool_view(env->id)
                                      << "\"" << endl;
                                 cout << (quad_list *)q << endl;
                             }
 
+                            if (print_cfg) {
+                                control_flow_graph cfg(q);
+                                cout << "\nControl flow graph for \""
+                                     << sym_tab->pool_view(env->id)
+                                     << "\"" << endl;
+                                cout << &cfg << endl;
+                            }
+
                             if (assembler) {
                                 cout << "Generating assembler for function \""
-                                     << sym_tab->pool_lookup(env->id) << "\""
+                                     << sym_tab->pool_view(env->id) << "\""
                                      << endl;
                                 code_gen->generate_assembler(q, env);
                             }
+                            delete q;
                         }
                     }
 
                     // Close the current scope.
                     sym_tab->close_scope();
+
+                    // The code for the block has been emitted, so all but
+                    // its head can be thrown away. The next token is a
+                    // keyword, so no string the scanner has handed out is
+                    // lost with the scope.
+                    if (release_scopes) {
+                        sym_tab->release_scope($1->sym_p);
+                    }
+                
+                    // Nothing refers to the AST of the block any longer.
+                    ast_arena.release(block_marks[env->level]);
                 }
                 ;
 
@@ -483,14 +552,20 @@ func_decl       : func_head opt_param_list T_COLON type_id T_SEMICOLON const_par
 
 proc_head       : T_PROCEDURE T_IDENT
                 {
+                    // Everything allocated from here on belongs to the new
+                    // block.
+                    arena_mark block_start = ast_arena.mark();
+
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     // We add the function id to the symbol table.
                     sym_index proc_loc = sym_tab->enter_procedure(pos,
                                                                   $2);
                     // Open a new scope.
                     sym_tab->open_scope();
+                    block_marks[sym_tab->get_symbol(proc_loc)->level] =
+                        block_start;
                     // This AST node is just a temporary node which we create
                     // here in order to be able to provide the symbol table
                     // index for the procedure to the proc_decl production
@@ -503,14 +578,20 @@ proc_head       : T_PROCEDURE T_IDENT
 
 func_head       : T_FUNCTION T_IDENT
                 {
+                    // Everything allocated from here on belongs to the new
+                    // block.
+                    arena_mark block_start = ast_arena.mark();
+
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     // We add the function id to the symbol table.
                     sym_index func_loc = sym_tab->enter_function(pos,
                                                                  $2);
                     // Open a new scope.
                     sym_tab->open_scope();
+                    block_marks[sym_tab->get_symbol(func_loc)->level] =
+                        block_start;
 
                     // This AST node is just a temporary node which we create
                     // here in order to be able to provide the symbol table
@@ -554,8 +635,8 @@ param_list      : param
 param           : T_IDENT T_COLON type_id
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
 
                     // Enter parameter into the symbol table. The linking of
                     // parameters and things is taken care of in the
@@ -587,8 +668,8 @@ stmt_list       : stmt
                     }
                     else {
                         position_information *pos =
-                            new position_information(@1.first_line,
-                                                 @1.first_column);
+                            new (ast_arena) position_information(@1.first_line,
+                                                                 @1.first_column);
                         $$ = new ast_stmt_list(pos, $1, NULL);
                     }
                 }
@@ -600,8 +681,8 @@ stmt_list       : stmt
                     }
                     else{
                         position_information *pos =
-                            new position_information(@1.first_line,
-                                                     @1.first_column);
+                            new (ast_arena) position_information(@1.first_line,
+                                                                 @1.first_column);
                         $$ = new ast_stmt_list(pos,$3,$1);
                     }
                 }
@@ -611,8 +692,8 @@ stmt_list       : stmt
 stmt            : T_IF expr T_THEN stmt_list elsif_list else_part T_END
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
 
                     $$ = new ast_if(pos,
                            $2,
@@ -623,8 +704,8 @@ stmt            : T_IF expr T_THEN stmt_list elsif_list else_part T_END
                 | T_WHILE expr T_DO stmt_list T_END
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     $$ = new ast_while(pos,
                             $2,
                             $4);
@@ -632,8 +713,8 @@ stmt            : T_IF expr T_THEN stmt_list elsif_list else_part T_END
                 | proc_id T_LEFTPAR opt_expr_list T_RIGHTPAR
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     $$ = new ast_procedurecall(pos,
                             $1,
                             $3);
@@ -641,8 +722,8 @@ stmt            : T_IF expr T_THEN stmt_list elsif_list else_part T_END
                 | lvariable T_ASSIGN expr
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     $$ = new ast_assign(pos,
                             $1,
                             $3);
@@ -650,16 +731,16 @@ stmt            : T_IF expr T_THEN stmt_list elsif_list else_part T_END
                 | T_RETURN expr
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     $$ = new ast_return(pos,
                             $2);
                 }
                 | T_RETURN
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     $$ = new ast_return(pos);
                 }
                 
@@ -707,8 +788,8 @@ rvariable       : rvar_id
 elsif_list      : elsif_list elsif
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
 
                     if ($1 == NULL){
                         $$ = new ast_elsif_list(pos, $2);
@@ -728,8 +809,8 @@ elsif_list      : elsif_list elsif
 elsif           : T_ELSIF expr T_THEN stmt_list
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     $$ = new ast_elsif(pos, 
                             $2,
                             $4);
@@ -804,16 +885,16 @@ simple_expr     : term
                 | T_SUB term
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     $$ = new ast_uminus(pos,
                             $2);
                 }
                 | simple_expr T_OR term
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     $$ = new ast_or(pos,
                             $1,
                             $3);
@@ -821,8 +902,8 @@ simple_expr     : term
                 | simple_expr T_ADD term
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     $$ = new ast_add(pos,
                             $1,
                             $3);
@@ -830,8 +911,8 @@ simple_expr     : term
                 | simple_expr T_SUB term
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     $$ = new ast_sub(pos,
                             $1,
                             $3);
@@ -846,8 +927,8 @@ term            : factor
                 | term T_AND factor
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     $$ = new ast_and(pos,
                             $1,
                             $3);
@@ -855,8 +936,8 @@ term            : factor
                 | term T_MUL factor
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     $$ = new ast_mult(pos,
                             $1,
                             $3);
@@ -864,8 +945,8 @@ term            : factor
                 | term T_RDIV factor
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     $$ = new ast_divide(pos,
                             $1,
                             $3);
@@ -873,8 +954,8 @@ term            : factor
                 | term T_IDIV factor
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     $$ = new ast_idiv(pos,
                             $1,
                             $3);
@@ -882,8 +963,8 @@ term            : factor
                 | term T_MOD factor
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     $$ = new ast_mod(pos,
                             $1,
                             $3);
@@ -910,8 +991,8 @@ factor          : rvariable
                 | T_NOT factor
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     $$ = new ast_not(pos,
                             $2);
                 }
@@ -927,8 +1008,8 @@ factor          : rvariable
 func_call       : func_id T_LEFTPAR opt_expr_list T_RIGHTPAR
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
                     $$ = new ast_functioncall(pos,
                             $1,
                             $3);
@@ -939,8 +1020,8 @@ func_call       : func_id T_LEFTPAR opt_expr_list T_RIGHTPAR
 integer         : T_INTNUM
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
 
                     // We need to pass on the value AND the position here.
                     $$ = new ast_integer(pos,
@@ -952,8 +1033,8 @@ integer         : T_INTNUM
 real            : T_REALNUM
                 {
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
 
                     // We create a new real constant.
                     $$ = new ast_real(pos,
@@ -1067,13 +1148,13 @@ id              : T_IDENT
                 {
                     sym_index sym_p;    // Used to find previous use of symbol.
                     position_information *pos =
-                        new position_information(@1.first_line,
-                                                 @1.first_column);
+                        new (ast_arena) position_information(@1.first_line,
+                                                             @1.first_column);
 
                     // Make sure the symbol was declared before it is used.
                     sym_p = sym_tab->lookup_symbol($1);
                     // debug() << "id -> T_IDENT: " << sym_p << " "
-                    //            << sym_tab->pool_lookup($1) << endl;
+                    //            << sym_tab->pool_view($1) << endl;
                     if (sym_p == NULL_SYM) {
                         type_error(pos) << "not declared: "
                                         << yytext << endl << flush;
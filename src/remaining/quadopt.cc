@@ -0,0 +1,1208 @@
+#include <iostream>
+#include <algorithm>
+#include <climits>
+#include "symtab.hh"
+#include "quads.hh"
+#include "cfg.hh"
+#include "codegen.hh"
+#include "quadopt.hh"
+
+using namespace std;
+
+// Defined in main.cc.
+extern bool verbose;
+
+quad_optimizer *quad_opt = new quad_optimizer();
+
+
+quad_optimizer::quad_optimizer() :
+    last_value_nr(0)
+{
+}
+
+
+/* This is the interface to parser.y. */
+quad_list *quad_optimizer::do_optimize(quad_list *q, symbol *env)
+{
+    control_flow_graph cfg(q);
+    delete q;
+
+    long removed = value_numbering(cfg);
+    if (verbose) {
+        cout << "Value numbering removed " << removed << " quads from \""
+             << sym_tab->pool_view(env->id) << "\"" << endl;
+    }
+
+    long folded;
+    long replaced = propagate(cfg, folded);
+    long immediates = use_immediates(cfg);
+    removed = remove_dead_code(cfg);
+    if (verbose) {
+        cout << "Propagation replaced " << replaced << " arguments and "
+             << "evaluated " << folded << " quads in \""
+             << sym_tab->pool_view(env->id) << "\", made " << immediates
+             << " arguments immediate, and removed " << removed
+             << " dead quads" << endl;
+    }
+
+    int old_ar_size = env->tag == SYM_FUNC ?
+                      env->get_function_symbol()->ar_size :
+                      env->get_procedure_symbol()->ar_size;
+    long in_registers;
+    int new_ar_size = share_slots(cfg, env, in_registers);
+    if (verbose) {
+        cout << "Register allocation put " << in_registers << " values of \""
+             << sym_tab->pool_view(env->id) << "\" in registers" << endl;
+        cout << "Activation record of \"" << sym_tab->pool_view(env->id)
+             << "\" went from " << old_ar_size << " to " << new_ar_size
+             << " bytes" << endl;
+    }
+
+    return cfg.linearize();
+}
+
+
+
+/*** Local value numbering. ***/
+
+/* An operation together with the value numbers of its arguments. Two quads
+   with equal keys compute the same value. For loads, a is the constant
+   loaded, and for array indexing it is the array symbol. */
+struct value_key
+{
+    long op;
+    long a;
+    long b;
+
+    value_key(long o, long x, long y) : op(o), a(x), b(y) {}
+
+    bool operator<(const value_key &k) const
+    {
+        if (op != k.op) {
+            return op < k.op;
+        }
+        if (a != k.a) {
+            return a < k.a;
+        }
+        return b < k.b;
+    }
+};
+
+
+/* A value available in a block: its number, and the temporary holding it. */
+struct value_holder
+{
+    long value_nr;
+    sym_index sym_p;
+};
+
+
+long quad_optimizer::get_value_nr(const sym_index sym_p)
+{
+    map<sym_index, long>::iterator i = value_nr.find(sym_p);
+    if (i == value_nr.end()) {
+        value_nr[sym_p] = ++last_value_nr;
+        return last_value_nr;
+    }
+    return i->second;
+}
+
+
+/* Number the values computed in a block. Whenever a quad computes a value
+   already held by an unchanged temporary, the quad is removed and the
+   temporary it assigned is renamed to the earlier one. Only temporaries
+   assigned exactly once are merged, so a renamed temporary holds the right
+   value wherever it is used, also in other blocks. Variables can only change
+   through assignment within the block, since calls end blocks. Array
+   elements can change through any store. */
+long quad_optimizer::value_number_block(basic_block &block,
+                                        map<sym_index, sym_index> &renamed,
+                                        map<sym_index, long> &assignments)
+{
+    map<value_key, value_holder> available;
+    long removed = 0;
+
+    value_nr.clear();
+
+    long i = 0;
+    while (i < (long) block.quads.size()) {
+        quadruple &q = block.quads[i];
+
+        // Use the earlier temporaries in place of the merged ones.
+        for (int arg = 1; arg <= 3; arg++) {
+            if (q.reads(arg) && renamed.count(q.get_arg(arg))) {
+                q.set_arg(arg, renamed[q.get_arg(arg)]);
+            }
+        }
+
+        long op = q.op_code;
+        long a;
+        long b = 0;
+
+        switch (q.op_code) {
+        case q_iload:
+        case q_rload:
+            a = q.int1;
+            break;
+
+        case q_inot:
+        case q_iuminus:
+        case q_ruminus:
+        case q_itor:
+            a = get_value_nr(q.sym1);
+            break;
+
+        case q_iplus:
+        case q_rplus:
+        case q_imult:
+        case q_rmult:
+        case q_ior:
+        case q_iand:
+        case q_ieq:
+        case q_req:
+        case q_ine:
+        case q_rne:
+            // Commutative, so the order of the arguments doesn't matter.
+            a = min(get_value_nr(q.sym1), get_value_nr(q.sym2));
+            b = max(get_value_nr(q.sym1), get_value_nr(q.sym2));
+            break;
+
+        case q_igt:
+            // a > b is the same thing as b < a.
+            op = q_ilt;
+            a = get_value_nr(q.sym2);
+            b = get_value_nr(q.sym1);
+            break;
+
+        case q_rgt:
+            op = q_rlt;
+            a = get_value_nr(q.sym2);
+            b = get_value_nr(q.sym1);
+            break;
+
+        case q_iminus:
+        case q_rminus:
+        case q_idivide:
+        case q_rdivide:
+        case q_imod:
+        case q_ilt:
+        case q_rlt:
+            a = get_value_nr(q.sym1);
+            b = get_value_nr(q.sym2);
+            break;
+
+        case q_lindex:
+        case q_irindex:
+        case q_rrindex:
+            a = q.sym1;
+            b = get_value_nr(q.sym2);
+            break;
+
+        case q_iassign:
+        case q_rassign:
+            // The variable now holds the value of the right hand side.
+            value_nr[q.sym3] = get_value_nr(q.sym1);
+            i++;
+            continue;
+
+        case q_istore:
+        case q_rstore: {
+            // Any array element read so far may have changed.
+            map<value_key, value_holder>::iterator j = available.begin();
+            while (j != available.end()) {
+                if (j->first.op == q_irindex || j->first.op == q_rrindex) {
+                    available.erase(j++);
+                } else {
+                    j++;
+                }
+            }
+            i++;
+            continue;
+        }
+
+        default:
+            // Whatever else a quad assigns gets a value of its own.
+            if (q.writes() != NULL_SYM) {
+                value_nr[q.writes()] = ++last_value_nr;
+            }
+            i++;
+            continue;
+        }
+
+        value_key key(op, a, b);
+        sym_index result = q.sym3;
+        map<value_key, value_holder>::iterator found = available.find(key);
+
+        if (found != available.end() &&
+            value_nr[found->second.sym_p] == found->second.value_nr &&
+            sym_tab->is_temp(result) &&
+            assignments[result] == 1 &&
+            assignments[found->second.sym_p] == 1) {
+            // Same value as before. Drop the quad and use the old temporary.
+            renamed[result] = found->second.sym_p;
+            block.quads.erase(block.quads.begin() + i);
+            removed++;
+            continue;
+        }
+
+        value_nr[result] = ++last_value_nr;
+        value_holder holder;
+        holder.value_nr = last_value_nr;
+        holder.sym_p = result;
+        available[key] = holder;
+        i++;
+    }
+
+    return removed;
+}
+
+
+long quad_optimizer::value_numbering(control_flow_graph &cfg)
+{
+    map<sym_index, sym_index> renamed;
+    map<sym_index, long> assignments;
+    long removed = 0;
+
+    for (long b = 0; b < cfg.size(); b++) {
+        for (unsigned long i = 0; i < cfg[b].quads.size(); i++) {
+            if (cfg[b].quads[i].writes() != NULL_SYM) {
+                assignments[cfg[b].quads[i].writes()]++;
+            }
+        }
+    }
+
+    for (long b = 0; b < cfg.size(); b++) {
+        removed += value_number_block(cfg[b], renamed, assignments);
+    }
+
+    // Blocks earlier in the graph may use temporaries merged later on.
+    if (!renamed.empty()) {
+        for (long b = 0; b < cfg.size(); b++) {
+            for (unsigned long i = 0; i < cfg[b].quads.size(); i++) {
+                quadruple &q = cfg[b].quads[i];
+                for (int arg = 1; arg <= 3; arg++) {
+                    if (q.reads(arg) && renamed.count(q.get_arg(arg))) {
+                        q.set_arg(arg, renamed[q.get_arg(arg)]);
+                    }
+                }
+            }
+        }
+    }
+
+    return removed;
+}
+
+
+
+/*** Copy and constant propagation. ***/
+
+/* A definition is a point where a symbol or temporary may get a new value.
+   Apart from the quads assigning something, there is an entry definition for
+   every symbol, standing for whatever value it had before the block of code
+   started, and a definition for every call, standing for whatever the call
+   did to the variables it can see. */
+struct definition
+{
+    // Where the definition is. block is -1 for entry definitions.
+    long block;
+    long pos;
+
+    // What is defined. NULL_SYM for calls, which may define any variable.
+    sym_index sym_p;
+};
+
+
+/* The reaching definitions of a control flow graph: which definitions a
+   symbol's value may come from at each point. The graph is walked block by
+   block, quad by quad, starting from the definitions reaching the start of
+   the block, and step() is called for each quad to move past it. */
+class reaching_definitions
+{
+private:
+    control_flow_graph &cfg;
+
+    vector<definition> defs;
+
+    // The definitions of each symbol and temporary, entry definition first.
+    map<sym_index, vector<long> > defs_of;
+
+    // All definitions of each symbol and temporary, as a set.
+    map<sym_index, bit_set> kill_of;
+
+    // The call definitions, and all definitions of variables (which calls
+    // kill, since we don't know what they do).
+    bit_set call_defs;
+    bit_set var_defs;
+
+    // The definitions reaching the start of each block.
+    vector<bit_set> reach_in;
+
+    // The number of the first definition in each block.
+    vector<long> first_def;
+
+    long add_def(const long, const long, const sym_index);
+
+public:
+    reaching_definitions(control_flow_graph &);
+
+    // The definitions reaching the start of a block, and the number of its
+    // first definition.
+    bit_set in(const long b) { return reach_in[b]; }
+    long first(const long b) { return first_def[b]; }
+
+    // Move a set of reaching definitions past a quad. Arg next is the
+    // number the quad's first definition has, and is moved past them.
+    void step(bit_set &, long &, quadruple &);
+
+    // The only definition of a symbol among a set of reaching definitions,
+    // or -1 if there are several, or it may have its entry value.
+    long unique_def(const bit_set &, const sym_index);
+
+    // The quad of a definition.
+    quadruple &quad(const long d) { return cfg[defs[d].block].quads[defs[d].pos]; }
+
+    // The number of quads assigning a symbol.
+    long assignments(const sym_index sym_p) { return defs_of[sym_p].size() - 1; }
+
+    // Return true if any call definition is in a set.
+    bool after_call(const bit_set &);
+};
+
+
+long reaching_definitions::add_def(const long b, const long pos,
+                                   const sym_index sym_p)
+{
+    definition d;
+    d.block = b;
+    d.pos = pos;
+    d.sym_p = sym_p;
+    defs.push_back(d);
+    if (sym_p != NULL_SYM) {
+        defs_of[sym_p].push_back(defs.size() - 1);
+    }
+    return defs.size() - 1;
+}
+
+
+reaching_definitions::reaching_definitions(control_flow_graph &g) :
+    cfg(g)
+{
+    // Entry definitions for everything mentioned.
+    for (long b = 0; b < cfg.size(); b++) {
+        for (unsigned long i = 0; i < cfg[b].quads.size(); i++) {
+            quadruple &q = cfg[b].quads[i];
+            for (int arg = 1; arg <= 3; arg++) {
+                sym_index sym_p = NULL_SYM;
+                if (q.reads(arg)) {
+                    sym_p = q.get_arg(arg);
+                } else if (arg == 3) {
+                    sym_p = q.writes();
+                }
+                if (sym_p != NULL_SYM && !defs_of.count(sym_p)) {
+                    add_def(-1, -1, sym_p);
+                }
+            }
+        }
+    }
+    long entry_count = defs.size();
+
+    // The quads' own definitions, in the order step() walks them.
+    for (long b = 0; b < cfg.size(); b++) {
+        first_def.push_back(defs.size());
+        for (unsigned long i = 0; i < cfg[b].quads.size(); i++) {
+            quadruple &q = cfg[b].quads[i];
+            if (q.op_code == q_call) {
+                add_def(b, i, NULL_SYM);
+            }
+            if (q.writes() != NULL_SYM) {
+                add_def(b, i, q.writes());
+            }
+        }
+    }
+
+    long def_count = defs.size();
+    call_defs = bit_set(def_count);
+    var_defs = bit_set(def_count);
+    for (long d = 0; d < def_count; d++) {
+        if (defs[d].sym_p == NULL_SYM) {
+            call_defs.insert(d);
+            var_defs.insert(d);
+        } else {
+            if (kill_of.find(defs[d].sym_p) == kill_of.end()) {
+                kill_of[defs[d].sym_p] = bit_set(def_count);
+            }
+            kill_of[defs[d].sym_p].insert(d);
+            if (!sym_tab->is_temp(defs[d].sym_p)) {
+                var_defs.insert(d);
+            }
+        }
+    }
+
+    // Iterate until nothing changes. Only the first block has the entry
+    // definitions coming in.
+    vector<bit_set> reach_out(cfg.size(), bit_set(def_count));
+    reach_in.assign(cfg.size(), bit_set(def_count));
+    if (cfg.size() > 0) {
+        for (long d = 0; d < entry_count; d++) {
+            reach_in[0].insert(d);
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (long b = 0; b < cfg.size(); b++) {
+            for (unsigned long p = 0; p < cfg[b].predecessors.size(); p++) {
+                reach_in[b].unite(reach_out[cfg[b].predecessors[p]]);
+            }
+            bit_set out = reach_in[b];
+            long next = first_def[b];
+            for (unsigned long i = 0; i < cfg[b].quads.size(); i++) {
+                step(out, next, cfg[b].quads[i]);
+            }
+            changed |= reach_out[b].unite(out);
+        }
+    }
+}
+
+
+void reaching_definitions::step(bit_set &reach, long &next, quadruple &q)
+{
+    if (q.op_code == q_call) {
+        reach.subtract(var_defs);
+        reach.insert(next++);
+    }
+    if (q.writes() != NULL_SYM) {
+        reach.subtract(kill_of[q.writes()]);
+        reach.insert(next++);
+    }
+}
+
+
+long reaching_definitions::unique_def(const bit_set &reach,
+                                      const sym_index sym_p)
+{
+    if (!sym_tab->is_temp(sym_p) && after_call(reach)) {
+        return -1;
+    }
+
+    vector<long> &candidates = defs_of[sym_p];
+    long found = -1;
+    for (unsigned long i = 0; i < candidates.size(); i++) {
+        if (reach.contains(candidates[i])) {
+            if (found != -1 || defs[candidates[i]].block == -1) {
+                return -1;
+            }
+            found = candidates[i];
+        }
+    }
+    return found;
+}
+
+
+bool reaching_definitions::after_call(const bit_set &reach)
+{
+    bit_set calls = call_defs;
+    calls.subtract(reach);
+    return !(calls == call_defs);
+}
+
+
+/* Evaluate an integer quad with constant arguments the way the generated code
+   would. Returns false if it can't be done at compile time. */
+static bool evaluate(quad_op_type op, long a, long b, long *result)
+{
+    // Wrap around on overflow like the machine does.
+    unsigned long ua = a;
+    unsigned long ub = b;
+
+    switch (op) {
+    case q_iplus:   *result = ua + ub; return true;
+    case q_iminus:  *result = ua - ub; return true;
+    case q_imult:   *result = ua * ub; return true;
+    case q_idivide:
+    case q_imod:
+        // Leave anything that traps for run time.
+        if (b == 0 || (b == -1 && a == LONG_MIN)) {
+            return false;
+        }
+        *result = op == q_idivide ? a / b : a % b;
+        return true;
+    case q_ior:     *result = a != 0 || b != 0; return true;
+    case q_iand:    *result = a != 0 && b != 0; return true;
+    case q_ieq:     *result = a == b; return true;
+    case q_ine:     *result = a != b; return true;
+    case q_ilt:     *result = a < b; return true;
+    case q_igt:     *result = a > b; return true;
+    case q_inot:    *result = a == 0; return true;
+    case q_iuminus: *result = 0 - ua; return true;
+    case q_iassign: *result = a; return true;
+    default:
+        return false;
+    }
+}
+
+
+/* Walk the graph with the reaching definitions. An argument whose only
+   reaching definition is a copy 'x := y' is replaced by y, as long as y
+   can't have changed since: either y is a temporary assigned only once, or
+   a variable that isn't assigned at all in this block of code and no call
+   may have changed it. A quad whose arguments all have a q_iload as their
+   only reaching definition is replaced by a q_iload of its result, and a
+   q_jmpf on a constant becomes a q_jmp or goes away. */
+long quad_optimizer::propagate(control_flow_graph &cfg, long &folded)
+{
+    reaching_definitions reaching(cfg);
+    long replaced = 0;
+    folded = 0;
+
+    for (long b = 0; b < cfg.size(); b++) {
+        bit_set reach = reaching.in(b);
+        long next = reaching.first(b);
+
+        for (unsigned long i = 0; i < cfg[b].quads.size(); i++) {
+            quadruple &q = cfg[b].quads[i];
+            bool constant[4] = { false, false, false, false };
+            long value[4] = { 0, 0, 0, 0 };
+            bool all_constant = true;
+
+            for (int arg = 1; arg <= 3; arg++) {
+                if (!q.reads(arg)) {
+                    continue;
+                }
+
+                long d = reaching.unique_def(reach, q.get_arg(arg));
+                if (d != -1 &&
+                    (reaching.quad(d).op_code == q_iassign ||
+                     reaching.quad(d).op_code == q_rassign)) {
+                    sym_index source = reaching.quad(d).sym1;
+                    sym_type tag = sym_tab->get_symbol_tag(source);
+                    bool unchanged;
+                    if (sym_tab->is_temp(source)) {
+                        unchanged = reaching.assignments(source) == 1;
+                    } else {
+                        unchanged = (tag == SYM_VAR || tag == SYM_PARAM) &&
+                                    reaching.assignments(source) == 0 &&
+                                    !reaching.after_call(reach);
+                    }
+                    if (unchanged) {
+                        q.set_arg(arg, source);
+                        replaced++;
+                        d = reaching.unique_def(reach, source);
+                    }
+                }
+
+                if (d != -1 && reaching.quad(d).op_code == q_iload) {
+                    constant[arg] = true;
+                    value[arg] = reaching.quad(d).int1;
+                } else {
+                    all_constant = false;
+                }
+            }
+
+            long result;
+            if (q.op_code == q_jmpf && constant[2]) {
+                folded++;
+                if (value[2] == 0) {
+                    cfg.replace(b, i, quadruple(q_jmp, q.int1,
+                                                NULL_SYM, NULL_SYM));
+                } else {
+                    // The q_jmpf is last in its block, so the walk ends.
+                    cfg.remove(b, i);
+                    break;
+                }
+            } else if (all_constant && constant[1] &&
+                       evaluate(q.op_code, value[1], value[2], &result)) {
+                q = quadruple(q_iload, result, NULL_SYM, q.sym3);
+                folded++;
+            }
+
+            reaching.step(reach, next, cfg[b].quads[i]);
+        }
+    }
+
+    return replaced;
+}
+
+
+/* Return the relation holding with its arguments swapped, or q_nop if the
+   quad isn't a relation or commutative. */
+static quad_op_type swapped(quad_op_type op)
+{
+    switch (op) {
+    case q_iplus:
+    case q_imult:
+    case q_ior:
+    case q_iand:
+    case q_ieq:
+    case q_ine:
+        return op;
+    case q_ilt:
+        return q_igt;
+    case q_igt:
+        return q_ilt;
+    default:
+        return q_nop;
+    }
+}
+
+
+/* Walk the graph with the reaching definitions again, and make the second
+   argument of quads taking an immediate there one, where its only reaching
+   definition is a q_iload of a constant fitting in an int. Where only the
+   first argument is such a constant, the arguments are swapped if the
+   operation allows it. The q_iloads left unused are removed as dead code
+   afterwards. */
+long quad_optimizer::use_immediates(control_flow_graph &cfg)
+{
+    reaching_definitions reaching(cfg);
+    long replaced = 0;
+
+    for (long b = 0; b < cfg.size(); b++) {
+        bit_set reach = reaching.in(b);
+        long next = reaching.first(b);
+
+        for (unsigned long i = 0; i < cfg[b].quads.size(); i++) {
+            quadruple &q = cfg[b].quads[i];
+            bool constant[3] = { false, false, false };
+            long value[3] = { 0, 0, 0 };
+
+            for (int arg = 1; arg <= 2; arg++) {
+                if (!q.takes_immediate() || !q.reads(arg)) {
+                    continue;
+                }
+                long d = reaching.unique_def(reach, q.get_arg(arg));
+                if (d != -1 && reaching.quad(d).op_code == q_iload &&
+                    reaching.quad(d).int1 == (int) reaching.quad(d).int1) {
+                    constant[arg] = true;
+                    value[arg] = reaching.quad(d).int1;
+                }
+            }
+
+            if (constant[2]) {
+                q.set_immediate(value[2]);
+                replaced++;
+            } else if (constant[1] && q.reads(2) &&
+                       swapped(q.op_code) != q_nop) {
+                q.op_code = swapped(q.op_code);
+                q.sym1 = q.sym2;
+                q.set_immediate(value[1]);
+                replaced++;
+            }
+
+            reaching.step(reach, next, q);
+        }
+    }
+
+    return replaced;
+}
+
+
+/* Remove quads whose only effect is to assign a temporary nobody uses. This
+   may make the temporaries they used unused in turn, so it is repeated until
+   nothing more goes. Calls have other effects, and divisions may trap, so
+   they are always kept. */
+long quad_optimizer::remove_dead_code(control_flow_graph &cfg)
+{
+    long removed = 0;
+    bool changed = true;
+
+    while (changed) {
+        changed = false;
+
+        map<sym_index, long> uses;
+        for (long b = 0; b < cfg.size(); b++) {
+            for (unsigned long i = 0; i < cfg[b].quads.size(); i++) {
+                quadruple &q = cfg[b].quads[i];
+                for (int arg = 1; arg <= 3; arg++) {
+                    if (q.reads(arg)) {
+                        uses[q.get_arg(arg)]++;
+                    }
+                }
+            }
+        }
+
+        for (long b = 0; b < cfg.size(); b++) {
+            long i = 0;
+            while (i < (long) cfg[b].quads.size()) {
+                quadruple &q = cfg[b].quads[i];
+                sym_index result = q.writes();
+                if (result != NULL_SYM && sym_tab->is_temp(result) &&
+                    uses[result] == 0 &&
+                    q.op_code != q_call &&
+                    q.op_code != q_idivide &&
+                    q.op_code != q_imod) {
+                    cfg[b].quads.erase(cfg[b].quads.begin() + i);
+                    removed++;
+                    changed = true;
+                } else {
+                    i++;
+                }
+            }
+        }
+    }
+
+    return removed;
+}
+
+
+
+/*** Stack slot sharing and register allocation. ***/
+
+/* The array indexed by a quad, or NULL_SYM. The array is an argument of the
+   quad, but its value isn't read, so quadruple::reads() leaves it out. */
+static sym_index indexed_array(const quadruple &q)
+{
+    switch (q.op_code) {
+    case q_lindex:
+    case q_irindex:
+    case q_rrindex:
+        return q.sym1;
+    default:
+        return NULL_SYM;
+    }
+}
+
+
+/* Return true if a symbol lives in the activation record of a block at some
+   level: it is a temporary of the block or a variable or array declared in
+   it. */
+static bool in_frame(const sym_index sym_p, const block_level level)
+{
+    if (sym_tab->is_temp(sym_p)) {
+        return true;
+    }
+    symbol *sym = sym_tab->get_symbol(sym_p);
+    return (sym->tag == SYM_VAR || sym->tag == SYM_ARRAY) &&
+           sym->level == level;
+}
+
+
+/* Blocks are optimized innermost first, so every use of a block's variables
+   from the blocks nested in it has been noted once the block itself comes
+   up. */
+bool quad_optimizer::note_uplevel(control_flow_graph &cfg,
+                                  const block_level level)
+{
+    bool outer = false;
+    for (long b = 0; b < cfg.size(); b++) {
+        for (unsigned long i = 0; i < cfg[b].quads.size(); i++) {
+            quadruple &q = cfg[b].quads[i];
+            for (int arg = 1; arg <= 4; arg++) {
+                sym_index sym_p;
+                if (arg == 4) {
+                    sym_p = indexed_array(q);
+                } else if (q.reads(arg)) {
+                    sym_p = q.get_arg(arg);
+                } else if (arg == 3) {
+                    sym_p = q.writes();
+                } else {
+                    continue;
+                }
+                if (sym_p == NULL_SYM || sym_tab->is_temp(sym_p)) {
+                    continue;
+                }
+                symbol *sym = sym_tab->get_symbol(sym_p);
+                if ((sym->tag == SYM_VAR || sym->tag == SYM_ARRAY) &&
+                    sym->level < level) {
+                    uplevel.insert(sym_p);
+                    outer |= !is_static(sym_p);
+                } else if (sym->tag == SYM_PARAM && sym->level < level) {
+                    outer = true;
+                }
+            }
+        }
+    }
+    return outer;
+}
+
+
+/* Find the lowest offset where size bytes are free in an activation record,
+   and mark them as used. Args: the used parts of the record, as sorted
+   (start, end) pairs, and the size. */
+static int allocate_slot(vector<pair<int, int> > &used, const int size)
+{
+    int offset = 0;
+    unsigned long i = 0;
+    while (i < used.size() && offset + size > used[i].first) {
+        offset = max(offset, used[i].second);
+        i++;
+    }
+    used.insert(used.begin() + i, make_pair(offset, offset + size));
+    return offset;
+}
+
+
+/* The liveness of the temporaries and local variables of a block that may be
+   moved out of the slots they were given when declared: those that inner
+   blocks don't use. */
+struct frame_liveness
+{
+    // The symbols, numbered in order of appearance.
+    map<sym_index, long> number;
+    vector<sym_index> symbols;
+
+    // The local arrays used by the block. These stay in memory, but may move.
+    set<sym_index> arrays;
+
+    // The symbols live at the start and at the end of each basic block.
+    vector<bit_set> live_in;
+    vector<bit_set> live_out;
+};
+
+
+/* Calculate which of the symbols of a block that may move are live where.
+   Calls can't use these (the others are in uplevel), so they don't make
+   anything live. */
+void quad_optimizer::find_liveness(control_flow_graph &cfg,
+                                   const block_level level,
+                                   frame_liveness &live)
+{
+    for (long b = 0; b < cfg.size(); b++) {
+        for (unsigned long i = 0; i < cfg[b].quads.size(); i++) {
+            quadruple &q = cfg[b].quads[i];
+            for (int arg = 1; arg <= 3; arg++) {
+                sym_index sym_p = NULL_SYM;
+                if (q.reads(arg)) {
+                    sym_p = q.get_arg(arg);
+                } else if (arg == 3) {
+                    sym_p = q.writes();
+                }
+                if (sym_p != NULL_SYM && in_frame(sym_p, level) &&
+                    !uplevel.count(sym_p) && !live.number.count(sym_p)) {
+                    live.number[sym_p] = live.symbols.size();
+                    live.symbols.push_back(sym_p);
+                }
+            }
+            if (indexed_array(q) != NULL_SYM &&
+                in_frame(indexed_array(q), level) &&
+                !is_static(indexed_array(q))) {
+                live.arrays.insert(indexed_array(q));
+            }
+        }
+    }
+    long count = live.symbols.size();
+
+    // What each block uses before assigning it, and what it assigns.
+    vector<bit_set> use(cfg.size(), bit_set(count));
+    vector<bit_set> def(cfg.size(), bit_set(count));
+    for (long b = 0; b < cfg.size(); b++) {
+        for (long i = cfg[b].quads.size() - 1; i >= 0; i--) {
+            quadruple &q = cfg[b].quads[i];
+            if (live.number.count(q.writes())) {
+                def[b].insert(live.number[q.writes()]);
+                use[b].erase(live.number[q.writes()]);
+            }
+            for (int arg = 1; arg <= 3; arg++) {
+                if (q.reads(arg) && live.number.count(q.get_arg(arg))) {
+                    use[b].insert(live.number[q.get_arg(arg)]);
+                }
+            }
+        }
+    }
+
+    // Iterate until nothing changes, last block first since liveness flows
+    // backwards.
+    live.live_in.assign(cfg.size(), bit_set(count));
+    live.live_out.assign(cfg.size(), bit_set(count));
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (long b = cfg.size() - 1; b >= 0; b--) {
+            for (unsigned long s = 0; s < cfg[b].successors.size(); s++) {
+                live.live_out[b].unite(live.live_in[cfg[b].successors[s]]);
+            }
+            bit_set in = live.live_out[b];
+            in.subtract(def[b]);
+            in.unite(use[b]);
+            changed |= live.live_in[b].unite(in);
+        }
+    }
+}
+
+
+/* The stretch of quads over which a symbol is live, counting two positions
+   per quad: the first where its arguments are read, the second where its
+   result is written. */
+struct live_interval
+{
+    long start;
+    long end;
+
+    // The symbol's number in the frame_liveness.
+    long n;
+};
+
+
+static bool starts_before(const live_interval &a, const live_interval &b)
+{
+    return a.start < b.start;
+}
+
+
+/* Hand out registers to the symbols of one type. The symbols are taken in
+   order of where they become live, and each gets a register no longer used
+   by any symbol whose interval has ended. When there is none, whichever of
+   the symbols holding one stays live the longest is spilled, ie, left in
+   memory for all of its life, since it would keep the register from the
+   most other symbols. Returns the number of symbols given a register. Args:
+   the intervals and the symbols, the type to allocate for, the registers to
+   hand out and their number, the register of each symbol (filled in). */
+static long linear_scan(const vector<live_interval> &intervals,
+                        const vector<sym_index> &symbols,
+                        const sym_index type,
+                        const register_type *registers,
+                        const int register_count,
+                        vector<int> &reg)
+{
+    vector<live_interval> candidates;
+    for (unsigned long n = 0; n < intervals.size(); n++) {
+        if (sym_tab->get_symbol_type(symbols[n]) == type &&
+            intervals[n].end != -1) {
+            candidates.push_back(intervals[n]);
+        }
+    }
+    stable_sort(candidates.begin(), candidates.end(), starts_before);
+
+    // Handed out from the back, so in the order they are listed.
+    vector<int> free_registers;
+    for (int r = register_count - 1; r >= 0; r--) {
+        free_registers.push_back(registers[r]);
+    }
+
+    vector<live_interval> active;
+    long allocated = 0;
+    for (unsigned long c = 0; c < candidates.size(); c++) {
+        live_interval &current = candidates[c];
+
+        // Take back the registers of symbols no longer live.
+        unsigned long a = 0;
+        while (a < active.size()) {
+            if (active[a].end < current.start) {
+                free_registers.push_back(reg[active[a].n]);
+                active.erase(active.begin() + a);
+            } else {
+                a++;
+            }
+        }
+
+        if (!free_registers.empty()) {
+            reg[current.n] = free_registers.back();
+            free_registers.pop_back();
+            active.push_back(current);
+            allocated++;
+            continue;
+        }
+
+        unsigned long longest = 0;
+        for (a = 1; a < active.size(); a++) {
+            if (active[a].end > active[longest].end) {
+                longest = a;
+            }
+        }
+        if (active[longest].end > current.end) {
+            reg[current.n] = reg[active[longest].n];
+            reg[active[longest].n] = NO_REGISTER;
+            active[longest] = current;
+        }
+    }
+
+    return allocated;
+}
+
+
+/* Linear scan register allocation, with integers in general purpose
+   registers and reals in XMM registers. Returns the number of symbols put in
+   registers; the last arg is set to the register of each symbol. */
+long quad_optimizer::allocate_registers(control_flow_graph &cfg,
+                                        frame_liveness &live,
+                                        const bool outer,
+                                        vector<int> &reg)
+{
+    long count = live.symbols.size();
+    vector<live_interval> intervals(count);
+    for (long n = 0; n < count; n++) {
+        intervals[n].start = LONG_MAX;
+        intervals[n].end = -1;
+        intervals[n].n = n;
+    }
+
+    long pos = 0;
+    for (long b = 0; b < cfg.size(); b++) {
+        long first = pos;
+        for (unsigned long i = 0; i < cfg[b].quads.size(); i++, pos++) {
+            quadruple &q = cfg[b].quads[i];
+            for (int arg = 1; arg <= 3; arg++) {
+                if (q.reads(arg) && live.number.count(q.get_arg(arg))) {
+                    live_interval &interval =
+                        intervals[live.number[q.get_arg(arg)]];
+                    interval.start = min(interval.start, 2 * pos);
+                    interval.end = max(interval.end, 2 * pos);
+                }
+            }
+            if (live.number.count(q.writes())) {
+                live_interval &interval = intervals[live.number[q.writes()]];
+                interval.start = min(interval.start, 2 * pos + 1);
+                interval.end = max(interval.end, 2 * pos + 1);
+            }
+        }
+        if (pos == first) {
+            continue;
+        }
+        for (long n = 0; n < count; n++) {
+            if (live.live_in[b].contains(n)) {
+                intervals[n].start = min(intervals[n].start, 2 * first);
+            }
+            if (live.live_out[b].contains(n)) {
+                intervals[n].end = max(intervals[n].end, 2 * pos - 1);
+            }
+        }
+    }
+
+    // The code generator wants DISPLAY_REGISTER, the last one, for the
+    // address of an outer activation record if there are any used.
+    reg.assign(count, NO_REGISTER);
+    return linear_scan(intervals, live.symbols, integer_type, allocatable,
+                       ALLOCATABLE_REGISTERS - (outer ? 1 : 0), reg) +
+           linear_scan(intervals, live.symbols, real_type,
+                       allocatable_xmm, ALLOCATABLE_XMM_REGISTERS, reg);
+}
+
+
+/* Put the temporaries and local variables of a block in registers where
+   there are registers to spare, and give two of those left in memory the
+   same slot unless one is assigned while the other is live. Variables and
+   arrays used by inner blocks stay at their offsets, and the slots and the
+   arrays only used here are then fitted around them. The variables of the
+   main program left in memory and its arrays are in static storage (see
+   codegen.hh), and keep their offsets there, out of the record. */
+int quad_optimizer::share_slots(control_flow_graph &cfg, symbol *env,
+                                long &in_registers)
+{
+    block_level level = env->level + 1;
+    bool outer = note_uplevel(cfg, level);
+
+    frame_liveness live;
+    find_liveness(cfg, level, live);
+    long count = live.symbols.size();
+
+    vector<int> reg;
+    in_registers = allocate_registers(cfg, live, outer, reg);
+
+    // Walk each block backwards, making everything assigned interfere with
+    // everything live after the assignment.
+    vector<bit_set> interferes(count, bit_set(count));
+    for (long b = 0; b < cfg.size(); b++) {
+        bit_set now_live = live.live_out[b];
+        for (long i = cfg[b].quads.size() - 1; i >= 0; i--) {
+            quadruple &q = cfg[b].quads[i];
+            if (live.number.count(q.writes())) {
+                long d = live.number[q.writes()];
+                for (long n = 0; n < count; n++) {
+                    if (n != d && now_live.contains(n)) {
+                        interferes[d].insert(n);
+                        interferes[n].insert(d);
+                    }
+                }
+                now_live.erase(d);
+            }
+            for (int arg = 1; arg <= 3; arg++) {
+                if (q.reads(arg) && live.number.count(q.get_arg(arg))) {
+                    now_live.insert(live.number[q.get_arg(arg)]);
+                }
+            }
+        }
+    }
+
+    // Give each symbol left in memory the lowest slot none of the symbols it
+    // interferes with has got.
+    vector<long> slot(count, -1);
+    long slot_count = 0;
+    for (long n = 0; n < count; n++) {
+        if (reg[n] != NO_REGISTER || is_static(live.symbols[n])) {
+            continue;
+        }
+        vector<bool> taken(slot_count + 1, false);
+        for (long m = 0; m < n; m++) {
+            if (slot[m] != -1 && interferes[n].contains(m)) {
+                taken[slot[m]] = true;
+            }
+        }
+        slot[n] = 0;
+        while (taken[slot[n]]) {
+            slot[n]++;
+        }
+        slot_count = max(slot_count, slot[n] + 1);
+    }
+
+    // Lay out the record: what inner blocks use first, where it was, then
+    // the arrays and the slots wherever there is room.
+    vector<pair<int, int> > used;
+    int ar_size = 0;
+    for (set<sym_index>::iterator u = uplevel.begin(); u != uplevel.end();
+         u++) {
+        symbol *sym = sym_tab->get_symbol(*u);
+        if (sym->level != level || is_static(*u)) {
+            continue;
+        }
+        int size = sym_tab->get_size(sym->type);
+        if (sym->tag == SYM_ARRAY) {
+            size *= sym->get_array_symbol()->array_cardinality;
+        }
+        pair<int, int> part(sym->offset, sym->offset + size);
+        used.insert(lower_bound(used.begin(), used.end(), part), part);
+        ar_size = max(ar_size, part.second);
+    }
+
+    for (set<sym_index>::iterator a = live.arrays.begin();
+         a != live.arrays.end(); a++) {
+        array_symbol *arr = sym_tab->get_symbol(*a)->get_array_symbol();
+        if (!uplevel.count(*a)) {
+            int size = arr->array_cardinality * sym_tab->get_size(arr->type);
+            arr->offset = allocate_slot(used, size);
+            ar_size = max(ar_size, arr->offset + size);
+        }
+    }
+
+    vector<int> slot_offset(slot_count);
+    for (long n = 0; n < slot_count; n++) {
+        slot_offset[n] = allocate_slot(used, STACK_WIDTH);
+        ar_size = max(ar_size, slot_offset[n] + STACK_WIDTH);
+    }
+
+    for (long n = 0; n < count; n++) {
+        sym_index sym_p = live.symbols[n];
+        if (sym_tab->is_temp(sym_p)) {
+            temp_info *temp = sym_tab->get_temp(sym_p);
+            temp->reg = reg[n];
+            if (slot[n] != -1) {
+                temp->offset = slot_offset[slot[n]];
+            }
+        } else {
+            variable_symbol *var =
+                sym_tab->get_symbol(sym_p)->get_variable_symbol();
+            var->reg = reg[n];
+            if (slot[n] != -1) {
+                var->offset = slot_offset[slot[n]];
+            }
+        }
+    }
+
+    if (env->tag == SYM_FUNC) {
+        env->get_function_symbol()->ar_size = ar_size;
+    } else {
+        env->get_procedure_symbol()->ar_size = ar_size;
+    }
+
+    // Nothing nested in this block is left to be optimized.
+    set<sym_index>::iterator u = uplevel.begin();
+    while (u != uplevel.end()) {
+        if (sym_tab->get_symbol(*u)->level == level) {
+            uplevel.erase(u++);
+        } else {
+            u++;
+        }
+    }
+
+    return ar_size;
+}
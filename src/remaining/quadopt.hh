@@ -0,0 +1,109 @@
+#ifndef __QUADOPT_HH__
+#define __QUADOPT_HH__
+
+#include <map>
+#include <set>
+
+#include "quads.hh"
+#include "cfg.hh"
+
+
+/*** This class performs optimization on the quads of a block, after they
+     have been generated from the (already optimized) AST. The quads are
+     split into basic blocks (see cfg.hh), which the passes below work on,
+     and then put back together for the code generator. ***/
+
+
+class quad_optimizer;
+struct frame_liveness;
+
+// Defined in quadopt.cc.
+extern quad_optimizer *quad_opt;
+
+
+class quad_optimizer
+{
+private:
+    // --- Local value numbering. ---
+
+    // The value number currently held by each symbol and temporary.
+    map<sym_index, long> value_nr;
+
+    // Last value number handed out.
+    long last_value_nr;
+
+    // Return the value number of a symbol or temporary, giving it a new one
+    // if it hasn't got one yet.
+    long get_value_nr(const sym_index);
+
+    // Remove recomputations of values within one basic block. Args: the
+    // block, the temporaries found to be copies of others (filled in), and
+    // the number of times each symbol or temporary is assigned.
+    long value_number_block(basic_block &, map<sym_index, sym_index> &,
+                            map<sym_index, long> &);
+
+    // Run local value numbering on every block of a graph. Returns the
+    // number of quads removed.
+    long value_numbering(control_flow_graph &);
+
+    // --- Copy and constant propagation. ---
+
+    // Replace arguments by the symbols they are copies of, and evaluate
+    // quads whose arguments are all constant. Returns the number of
+    // arguments replaced; the second arg is set to the number of quads
+    // evaluated.
+    long propagate(control_flow_graph &, long &);
+
+    // Make constant second arguments immediates. Returns the number of
+    // arguments made immediate.
+    long use_immediates(control_flow_graph &);
+
+    // Remove quads assigning temporaries that are never used. Returns the
+    // number of quads removed.
+    long remove_dead_code(control_flow_graph &);
+
+    // --- Stack slot sharing and register allocation. ---
+
+    // Variables and arrays used by blocks nested deeper than the one
+    // declaring them. Their offsets are in the code of those blocks already,
+    // so they have to stay where they are.
+    set<sym_index> uplevel;
+
+    // Add the variables and arrays of outer blocks used by a graph to
+    // uplevel. Returns true if the graph uses any variables, parameters or
+    // arrays of outer blocks. Args: the graph, the level of its local
+    // variables.
+    bool note_uplevel(control_flow_graph &, const block_level);
+
+    // Find which of the temporaries and local variables of a graph that
+    // may move out of their slots are live where. Args: the graph, the
+    // level of its local variables, the liveness (filled in).
+    void find_liveness(control_flow_graph &, const block_level,
+                       frame_liveness &);
+
+    // Give registers to as many temporaries and local variables as
+    // possible. Returns the number given one. Args: the graph, its
+    // liveness, whether it uses outer blocks' variables (which keeps
+    // DISPLAY_REGISTER free), the register of each symbol or NO_REGISTER
+    // (filled in).
+    long allocate_registers(control_flow_graph &, frame_liveness &,
+                            const bool, vector<int> &);
+
+    // Put temporaries and local variables in registers, let those left in
+    // memory that are never live at the same time share a slot in the
+    // activation record, and lay the record out again. Returns the new size
+    // of the record. Args: the graph, the procedure or function it belongs
+    // to, the number of symbols put in registers (set).
+    int share_slots(control_flow_graph &, symbol *, long &);
+
+public:
+    quad_optimizer();
+
+    // This is the interface to parser.y. Takes the quads of a block and
+    // returns an optimized quad list to generate code from. The list given
+    // as argument is deleted. Args: quads, the procedure they belong to.
+    quad_list *do_optimize(quad_list *, symbol *);
+};
+
+
+#endif
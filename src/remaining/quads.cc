@@ -1,6 +1,9 @@
 #include <iostream>
 #include <iomanip>
+#include <sstream>
+#include <algorithm>
 #include <stdio.h>
+#include <assert.h>
 #include "symtab.hh"
 #include "ast.hh"
 #include "quads.hh"
@@ -11,37 +14,167 @@ using namespace std;
 #define USE_Q { quad_list *foo = &q; foo = foo; }
 
 
-/* Constructors for quadruples. The order of assigning the member fields might
-   looks strange, but it's arranged in the same order as they are declared
-   in quads.hh to avoid compiler rearrangements. */
+/* Constructors for quadruples. Every argument is stored once; sym2 and sym3
+   must fit in an int, which all symbols, temporaries and labels do. */
 quadruple::quadruple(quad_op_type op, long a1, long a2, long a3) :
-    op_code(op),
     sym1(a1),
     sym2(a2),
     sym3(a3),
-    int1(a1),
-    int2(a2),
-    int3(a3)
+    op_code(op),
+    immediate(false)
 {
+    assert(sym2 == a2 && sym3 == a3);
 }
 
+quadruple::quadruple() :
+    sym1(NULL_SYM),
+    sym2(NULL_SYM),
+    sym3(NULL_SYM),
+    op_code(q_nop),
+    immediate(false)
+{
+}
 
 
 
-/* The quad_list_element constructor. Not very exciting really. This class
-   is never used outside the quad_list class. */
-quad_list_element::quad_list_element(quadruple *q, quad_list_element *n) :
-    data(q),
-    next(n)
+bool quadruple::reads(const int arg)
 {
+    if (immediate && arg == 2) {
+        return false;
+    }
+    switch (op_code) {
+    case q_inot:
+    case q_ruminus:
+    case q_iuminus:
+    case q_rassign:
+    case q_iassign:
+    case q_itor:
+    case q_param:
+        return arg == 1;
+    case q_rplus:
+    case q_iplus:
+    case q_rminus:
+    case q_iminus:
+    case q_ior:
+    case q_iand:
+    case q_rmult:
+    case q_imult:
+    case q_rdivide:
+    case q_idivide:
+    case q_imod:
+    case q_req:
+    case q_ieq:
+    case q_rne:
+    case q_ine:
+    case q_rlt:
+    case q_ilt:
+    case q_rgt:
+    case q_igt:
+        return arg == 1 || arg == 2;
+    case q_rstore:
+    case q_istore:
+        return arg == 1 || arg == 3;
+    case q_rreturn:
+    case q_ireturn:
+    case q_lindex:
+    case q_rrindex:
+    case q_irindex:
+    case q_jmpf:
+        return arg == 2;
+    default:
+        return false;
+    }
 }
 
 
+sym_index quadruple::writes()
+{
+    switch (op_code) {
+    case q_rstore:
+    case q_istore:
+    case q_rreturn:
+    case q_ireturn:
+    case q_jmp:
+    case q_jmpf:
+    case q_param:
+    case q_labl:
+    case q_nop:
+        return NULL_SYM;
+    default:
+        // Including q_call, where sym3 is NULL_SYM for procedures.
+        return sym3;
+    }
+}
+
+
+sym_index quadruple::get_arg(const int arg)
+{
+    switch (arg) {
+    case 1:
+        return sym1;
+    case 2:
+        return sym2;
+    default:
+        return sym3;
+    }
+}
+
+
+void quadruple::set_arg(const int arg, const sym_index sym_p)
+{
+    switch (arg) {
+    case 1:
+        sym1 = sym_p;
+        break;
+    case 2:
+        sym2 = sym_p;
+        break;
+    default:
+        sym3 = sym_p;
+        break;
+    }
+    assert(get_arg(arg) == sym_p);
+}
+
+
+bool quadruple::takes_immediate()
+{
+    switch (op_code) {
+    case q_iplus:
+    case q_iminus:
+    case q_ior:
+    case q_iand:
+    case q_imult:
+    case q_idivide:
+    case q_imod:
+    case q_ieq:
+    case q_ine:
+    case q_ilt:
+    case q_igt:
+    case q_lindex:
+    case q_rrindex:
+    case q_irindex:
+    case q_ireturn:
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+void quadruple::set_immediate(const long value)
+{
+    assert(takes_immediate() && value == (int) value);
+    int2 = value;
+    immediate = true;
+}
+
 
 /* The quad_list_iterator constructor. It initializes the iterator to point
    to the first element of the quad list passed to it as an argument. */
 quad_list_iterator::quad_list_iterator(quad_list *q_list) :
-    current(q_list->head)
+    list(q_list),
+    current(0)
 {
 }
 
@@ -49,52 +182,74 @@ quad_list_iterator::quad_list_iterator(quad_list *q_list) :
    we've reached the end of the list. */
 quadruple *quad_list_iterator::get_current()
 {
-    if (current == NULL) {
+    if (current >= list->quad_count) {
         return NULL;
     }
 
-    return current->data;
+    return &list->quads[current];
 }
 
 /* Return the next quadruple on the quad list we're iterating over, or NULL if
    there are no more. */
 quadruple *quad_list_iterator::get_next()
 {
-    if (current->next == NULL) {
+    if (current + 1 >= list->quad_count) {
         return NULL;
     }
 
-    current = current->next;
-    return current->data;
+    current++;
+    return &list->quads[current];
 }
 
 
 
 /* The quad_list class. */
 quad_list::quad_list(int ll) :
-    head(NULL),
-    tail(NULL),
+    quads(new quadruple[BASE_QUAD_CAPACITY]),
+    quad_count(0),
+    capacity(BASE_QUAD_CAPACITY),
     last_label(ll)
 {
-    quad_nr = 1;
 }
 
 
-/* Operator for adding on a new quadruple to the list. */
-quad_list &quad_list::operator+=(quadruple *q)
+quad_list::~quad_list()
 {
-    if (head == NULL) {
-        head = new quad_list_element(q, NULL);
-        tail = head;
-    } else {
-        tail->next = new quad_list_element(q, NULL);
-        tail = tail->next;
+    delete[] quads;
+}
+
+
+/* Operator for adding on a new quadruple to the list. The array doubles in
+   size when it is full, so adding n quads costs O(n) copying in total. */
+quad_list &quad_list::operator+=(const quadruple &q)
+{
+    if (quad_count == capacity) {
+        quadruple *tmp_quads = new quadruple[2 * capacity];
+        copy(quads, quads + quad_count, tmp_quads);
+        delete[] quads;
+        quads = tmp_quads;
+        capacity *= 2;
     }
 
+    quads[quad_count++] = q;
+
     return *this;
 }
 
 
+long quad_list::size()
+{
+    return quad_count;
+}
+
+
+quadruple &quad_list::operator[](const long i)
+{
+    assert(i >= 0 && i < quad_count);
+    return quads[i];
+}
+
+
 
 /**************************************************************
  *** THE AST NODE METHODS FOR GENERATING QUADS FOLLOW HERE. ***
@@ -147,7 +302,7 @@ sym_index ast_integer::generate_quads(quad_list &q)
     USE_Q;
     sym_index temp_index = sym_tab->gen_temp_var(integer_type);
     // value - internal in ast_integer, q_iload - enum quads.hh, q - quads list
-    q += new quadruple(q_iload, value, NULL_SYM, temp_index);
+    q += quadruple(q_iload, value, NULL_SYM, temp_index);
     return temp_index;
 }
 
@@ -157,7 +312,7 @@ sym_index ast_real::generate_quads(quad_list &q)
     USE_Q;
     sym_index temp_index = sym_tab->gen_temp_var(real_type);
     // value - internal in ast_integer, q_rload - enum quads.hh, q - quads list
-    q += new quadruple(q_rload, sym_tab->ieee(value), NULL_SYM, temp_index);
+    q += quadruple(q_rload, sym_tab->ieee(value), NULL_SYM, temp_index);
     return temp_index;
 }
 
@@ -171,13 +326,13 @@ sym_index do_binaryoperation(quad_list &q, quad_op_type quad_int, quad_op_type q
     left_index = node->left->generate_quads(q);
     right_index = node->right->generate_quads(q);
     temp_index = sym_tab->gen_temp_var(integer_type);
-    q += new quadruple(quad_int, left_index, right_index, temp_index);
+    q += quadruple(quad_int, left_index, right_index, temp_index);
   }
   else if (node->type == real_type) {
     left_index = node->left->generate_quads(q);
     right_index = node->right->generate_quads(q);
     temp_index = sym_tab->gen_temp_var(real_type);
-    q += new quadruple(quad_real, left_index, right_index, temp_index);
+    q += quadruple(quad_real, left_index, right_index, temp_index);
   }
   else {
     fatal("Invalid type of ast_binaryoperation node, should not happen!!");
@@ -191,12 +346,12 @@ sym_index do_special_operation(quad_list &q, quad_op_type quad_int, quad_op_type
   if (node->type == integer_type) {
     special_index = node->generate_quads(q);
     temp_index = sym_tab->gen_temp_var(integer_type);
-    q += new quadruple(quad_int, special_index, special_index, temp_index);
+    q += quadruple(quad_int, special_index, special_index, temp_index);
   }
   else if (node->type == real_type) {
     special_index = node->generate_quads(q);
     temp_index = sym_tab->gen_temp_var(real_type);
-    q += new quadruple(quad_real, special_index, NULL_SYM, temp_index);
+    q += quadruple(quad_real, special_index, NULL_SYM, temp_index);
   }
   else {
     fatal("Invalid type of ast_expression node, should not happen!!");
@@ -211,13 +366,13 @@ sym_index do_binaryrelation(quad_list &q, quad_op_type quad_int, quad_op_type qu
     left_index = node->left->generate_quads(q);
     right_index = node->right->generate_quads(q);
     temp_index = sym_tab->gen_temp_var(integer_type);
-    q += new quadruple(quad_int, left_index, right_index, temp_index);
+    q += quadruple(quad_int, left_index, right_index, temp_index);
   }
   else if (node->left->type == real_type && node->right->type == real_type) {
     left_index = node->left->generate_quads(q);
     right_index = node->right->generate_quads(q);
     temp_index = sym_tab->gen_temp_var(real_type);
-    q += new quadruple(quad_real, left_index, right_index, temp_index);
+    q += quadruple(quad_real, left_index, right_index, temp_index);
   }
   else {
     fatal("Invalid type of left or right in ast_binaryrelation, should not happen!!");
@@ -255,7 +410,7 @@ sym_index ast_cast::generate_quads(quad_list &q)
     sym_index quad_index = expr->generate_quads(q);
     sym_index temp_index = sym_tab->gen_temp_var(real_type);
     // q_itor - type conversion from integer to real (result)
-    q += new quadruple(q_itor, quad_index, NULL_SYM, temp_index);
+    q += quadruple(q_itor, quad_index, NULL_SYM, temp_index);
     return temp_index;
 }
 
@@ -309,6 +464,74 @@ sym_index ast_and::generate_quads(quad_list &q)
 }
 
 
+/* Conditions. An expression used as the condition of an if, elsif or while
+   statement is only needed to decide where to jump, so 'and', 'or' and 'not'
+   are turned into jumps rather than values. The right operand of 'and' and
+   'or' is then only evaluated when the left one doesn't decide the outcome.
+   Anything else is evaluated as a value and tested. */
+void ast_expression::generate_jump_if_false(quad_list &q, int label)
+{
+    sym_index pos = generate_quads(q);
+    q += quadruple(q_jmpf, label, pos, NULL_SYM);
+}
+
+
+void ast_expression::generate_jump_if_true(quad_list &q, int label)
+{
+    // There is no q_jmpt, so jump past an unconditional jump instead. The
+    // code generator makes a single jump out of this.
+    int skip = sym_tab->get_next_label();
+    sym_index pos = generate_quads(q);
+    q += quadruple(q_jmpf, skip, pos, NULL_SYM);
+    q += quadruple(q_jmp, label, NULL_SYM, NULL_SYM);
+    q += quadruple(q_labl, skip, NULL_SYM, NULL_SYM);
+}
+
+
+void ast_not::generate_jump_if_false(quad_list &q, int label)
+{
+    expr->generate_jump_if_true(q, label);
+}
+
+
+void ast_not::generate_jump_if_true(quad_list &q, int label)
+{
+    expr->generate_jump_if_false(q, label);
+}
+
+
+void ast_and::generate_jump_if_false(quad_list &q, int label)
+{
+    left->generate_jump_if_false(q, label);
+    right->generate_jump_if_false(q, label);
+}
+
+
+void ast_and::generate_jump_if_true(quad_list &q, int label)
+{
+    int skip = sym_tab->get_next_label();
+    left->generate_jump_if_false(q, skip);
+    right->generate_jump_if_true(q, label);
+    q += quadruple(q_labl, skip, NULL_SYM, NULL_SYM);
+}
+
+
+void ast_or::generate_jump_if_false(quad_list &q, int label)
+{
+    int skip = sym_tab->get_next_label();
+    left->generate_jump_if_true(q, skip);
+    right->generate_jump_if_false(q, label);
+    q += quadruple(q_labl, skip, NULL_SYM, NULL_SYM);
+}
+
+
+void ast_or::generate_jump_if_true(quad_list &q, int label)
+{
+    left->generate_jump_if_true(q, label);
+    right->generate_jump_if_true(q, label);
+}
+
+
 
 sym_index ast_equal::generate_quads(quad_list &q)
 {
@@ -343,9 +566,9 @@ sym_index ast_greaterthan::generate_quads(quad_list &q)
 void ast_id::generate_assignment(quad_list &q, sym_index rhs)
 {
     if (type == integer_type) {
-        q += new quadruple(q_iassign, rhs, NULL_SYM, sym_p);
+        q += quadruple(q_iassign, rhs, NULL_SYM, sym_p);
     } else if (type == real_type) {
-        q += new quadruple(q_rassign, rhs, NULL_SYM, sym_p);
+        q += quadruple(q_rassign, rhs, NULL_SYM, sym_p);
     } else {
         fatal("Illegal type in ast_id::generate_assignment()");
     }
@@ -356,12 +579,12 @@ void ast_indexed::generate_assignment(quad_list &q, sym_index rhs)
     sym_index index_pos = index->generate_quads(q);
     sym_index address = sym_tab->gen_temp_var(integer_type);
 
-    q += new quadruple(q_lindex, id->sym_p, index_pos, address);
+    q += quadruple(q_lindex, id->sym_p, index_pos, address);
 
     if (type == integer_type) {
-        q += new quadruple(q_istore, rhs, NULL_SYM, address);
+        q += quadruple(q_istore, rhs, NULL_SYM, address);
     } else if (type == real_type) {
-        q += new quadruple(q_rstore, rhs, NULL_SYM, address);
+        q += quadruple(q_rstore, rhs, NULL_SYM, address);
     } else {
         fatal("Illegal type in ast_indexed::generate_assignment()");
     }
@@ -401,7 +624,7 @@ void ast_expr_list::generate_parameter_list(quad_list &q,
   if (last_expr != NULL) {
       (*nr_params)++;
       // whats if it is a real or int
-      q += new quadruple(q_param,last_expr->generate_quads(q),NULL_SYM,NULL_SYM);
+      q += quadruple(q_param,last_expr->generate_quads(q),NULL_SYM,NULL_SYM);
       // recursive call with preceding parameter symbol, NULL if none
   }
   if(preceding != NULL){
@@ -419,7 +642,7 @@ sym_index ast_procedurecall::generate_quads(quad_list &q)
     int parameters = 0;
     if(parameter_list != NULL)
         parameter_list->generate_parameter_list(q, parameter_list, &parameters);
-    q += new quadruple(q_call, id->sym_p, parameters, NULL_SYM);
+    q += quadruple(q_call, id->sym_p, parameters, NULL_SYM);
 
     return NULL_SYM;
 }
@@ -435,7 +658,7 @@ sym_index ast_functioncall::generate_quads(quad_list &q)
     if(parameter_list != NULL)
         parameter_list->generate_parameter_list(q, parameter_list, &parameters);
 
-    q += new quadruple(q_call, id->sym_p, parameters, index_pos);
+    q += quadruple(q_call, id->sym_p, parameters, index_pos);
 
     return index_pos;
 }
@@ -450,22 +673,21 @@ sym_index ast_while::generate_quads(quad_list &q)
     int bottom = sym_tab->get_next_label();
 
     // Here's the label for the top of the while body.
-    q += new quadruple(q_labl, top, NULL_SYM, NULL_SYM);
+    q += quadruple(q_labl, top, NULL_SYM, NULL_SYM);
 
     // Generate quads for the condition. After this code is being run, we
     // check if the result in the variable stored in 'pos' is 0. If it is,
     // we want to exit the loop, which is done via a conditional jump to the
     // 'bottom' label.
-    sym_index pos = condition->generate_quads(q);
-    q += new quadruple(q_jmpf, bottom, pos, NULL_SYM);
+    condition->generate_jump_if_false(q, bottom);
 
     // Generate quads for the body. Following these come an unconditional
     // jump to the 'top' label, ie, run the condition etc again.
-    pos = body->generate_quads(q);
-    q += new quadruple(q_jmp, top,  NULL_SYM, NULL_SYM);
+    body->generate_quads(q);
+    q += quadruple(q_jmp, top,  NULL_SYM, NULL_SYM);
 
     // This is where we jump to if the while condition evaluates to false.
-    q += new quadruple(q_labl, bottom, NULL_SYM, NULL_SYM);
+    q += quadruple(q_labl, bottom, NULL_SYM, NULL_SYM);
 
     return NULL_SYM;
 }
@@ -477,20 +699,19 @@ void ast_elsif::generate_quads_and_jump(quad_list &q, int label)
 {
     USE_Q;
     /* Your code here */
-    sym_index index_pos = condition->generate_quads(q);
     int top = sym_tab->get_next_label();
 
-    // q_jmpf - conditional jump
-    q += new quadruple(q_jmpf, top, index_pos, NULL_SYM);
+    // jump past the body if the condition is false
+    condition->generate_jump_if_false(q, top);
 
     if (body != NULL) {
       body->generate_quads(q);
     }
 
     // q_jmp - absolute jump
-    q += new quadruple(q_jmp, label, NULL_SYM, NULL_SYM);
+    q += quadruple(q_jmp, label, NULL_SYM, NULL_SYM);
     // q_labl - label for jumping
-    q += new quadruple(q_labl, top, NULL_SYM, NULL_SYM);
+    q += quadruple(q_labl, top, NULL_SYM, NULL_SYM);
 }
 
 
@@ -512,10 +733,9 @@ sym_index ast_if::generate_quads(quad_list &q)
 {
     USE_Q;
     /* Your code here */
-    sym_index index_pos = condition->generate_quads(q);
     int top = sym_tab->get_next_label();
-    // q_jmpf - conditional jump
-    q += new quadruple(q_jmpf, top, index_pos, NULL_SYM);
+    // jump past the body if the condition is false
+    condition->generate_jump_if_false(q, top);
 
     int end = sym_tab->get_next_label();
 
@@ -523,20 +743,20 @@ sym_index ast_if::generate_quads(quad_list &q)
       body->generate_quads(q);
       if (else_body != NULL || elsif_list != NULL) {
         // q_jmp - absolute jump
-        q += new quadruple(q_jmp, end, NULL_SYM, NULL_SYM);
+        q += quadruple(q_jmp, end, NULL_SYM, NULL_SYM);
       }
     }
     // incomplete function:
 
     if (elsif_list != NULL) {
       // q_labl - marks a jump point
-      q += new quadruple(q_labl, top, NULL_SYM, NULL_SYM);
+      q += quadruple(q_labl, top, NULL_SYM, NULL_SYM);
       // call to function above since it was pre-defined template function
       elsif_list->generate_quads_and_jump(q, end);
     }
     else {
       // q_labl - marks a jump point
-      q += new quadruple(q_labl, top, NULL_SYM, NULL_SYM);
+      q += quadruple(q_labl, top, NULL_SYM, NULL_SYM);
     }
 
     if (else_body != NULL) {
@@ -544,7 +764,7 @@ sym_index ast_if::generate_quads(quad_list &q)
       else_body->generate_quads(q);
     }
     // q_labl - marks a jump point
-    q += new quadruple(q_labl, end, NULL_SYM, NULL_SYM);
+    q += quadruple(q_labl, end, NULL_SYM, NULL_SYM);
     return NULL_SYM;
 }
 
@@ -560,11 +780,11 @@ sym_index ast_return::generate_quads(quad_list &q)
       // value->type is of sym_index type and says integer_type, real_type etc
       if (value->type == integer_type) {
         // q_ireturn - return integer value, q.last_label - label marking the end of a quad list
-        q += new quadruple(q_ireturn, q.last_label, index_pos, NULL_SYM);
+        q += quadruple(q_ireturn, q.last_label, index_pos, NULL_SYM);
       }
       else if (value->type == real_type) { 
         // q_rreturn - return real value
-        q += new quadruple(q_rreturn, q.last_label, index_pos, NULL_SYM);
+        q += quadruple(q_rreturn, q.last_label, index_pos, NULL_SYM);
       }
       else {
         fatal("Unknown return type detected in ast_return::generate_quads() quads.cc");
@@ -573,7 +793,7 @@ sym_index ast_return::generate_quads(quad_list &q)
     }
     else {
       // q_jmp - absolute jump
-      q += new quadruple(q_jmp, q.last_label, NULL_SYM, NULL_SYM);
+      q += quadruple(q_jmp, q.last_label, NULL_SYM, NULL_SYM);
     }
     return NULL_SYM;
 }
@@ -593,10 +813,10 @@ sym_index ast_indexed::generate_quads(quad_list &q)
 
     // maybe we should check for other types? 
     if (type == integer_type) {
-      q += new quadruple(q_irindex, lhs, rhs, i);
+      q += quadruple(q_irindex, lhs, rhs, i);
     }
     else if (type == real_type) {
-      q += new quadruple(q_rrindex, lhs, rhs, i);
+      q += quadruple(q_rrindex, lhs, rhs, i);
     }
     else {
       fatal("Unknown type detected in ast_indexed::generate_quads() quads.cc");
@@ -643,6 +863,9 @@ sym_index ast_functionhead::generate_quads(quad_list &q)
    care of adding a last_label. The code is identical for the two methods. */
 quad_list *ast_procedurehead::do_quads(ast_stmt_list *s)
 {
+    // The temporaries of the previous block are no longer needed.
+    sym_tab->reset_temps();
+
     int last_label = sym_tab->get_next_label();
     quad_list *q = new quad_list(last_label);
 
@@ -650,13 +873,16 @@ quad_list *ast_procedurehead::do_quads(ast_stmt_list *s)
         s->generate_quads(*q);
     }
 
-    (*q) += new quadruple(q_labl, last_label, NULL_SYM, NULL_SYM);
+    (*q) += quadruple(q_labl, last_label, NULL_SYM, NULL_SYM);
 
     return q;
 }
 
 quad_list *ast_functionhead::do_quads(ast_stmt_list *s)
 {
+    // The temporaries of the previous block are no longer needed.
+    sym_tab->reset_temps();
+
     int last_label = sym_tab->get_next_label();
     quad_list *q = new quad_list(last_label);
 
@@ -664,7 +890,7 @@ quad_list *ast_functionhead::do_quads(ast_stmt_list *s)
         s->generate_quads(*q);
     }
 
-    (*q) += new quadruple(q_labl, last_label, NULL_SYM, NULL_SYM);
+    (*q) += quadruple(q_labl, last_label, NULL_SYM, NULL_SYM);
 
     return q;
 }
@@ -675,6 +901,37 @@ quad_list *ast_functionhead::do_quads(ast_stmt_list *s)
  **********************************/
 
 
+/* A quad argument is either a symbol, a temporary or an immediate. Sending
+   one of these to an outstream prints it like a symbol would be printed,
+   with temporaries printed as $N where N is their number and immediates as
+   #C where C is the constant. Honours setw(). */
+class quad_argument
+{
+public:
+    sym_index sym_p;
+
+    // True if the argument is an immediate, printed as the constant.
+    bool immediate;
+
+    quad_argument(sym_index s, bool i = false) : sym_p(s), immediate(i) {}
+};
+
+static ostream &operator<<(ostream &o, const quad_argument &a)
+{
+    if (a.immediate) {
+        ostringstream value;
+        value << "#" << a.sym_p;
+        return o << value.str();
+    }
+    if (sym_tab->is_temp(a.sym_p)) {
+        ostringstream name;
+        name << "$" << a.sym_p - TEMP_BASE;
+        return o << name.str();
+    }
+    return o << sym_tab->get_symbol(a.sym_p);
+}
+
+
 void quadruple::print(ostream &o)
 {
     o << "    ";
@@ -684,211 +941,211 @@ void quadruple::print(ostream &o)
         o << setw(11) << "q_rload"
           << setw(11) << int1
           << setw(11) << "-"
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym3);
         break;
     case q_iload:
         o << setw(11) << "q_iload"
           << setw(11) << int1
           << setw(11) << "-"
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym3);
         break;
     case q_inot:
         o << setw(11) << "q_inot"
-          << setw(11) << sym_tab->get_symbol(sym1)
+          << setw(11) << quad_argument(sym1)
           << setw(11) << "-"
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym3);
         break;
     case q_ruminus:
         o << setw(11) << "q_ruminus"
-          << setw(11) << sym_tab->get_symbol(sym1)
+          << setw(11) << quad_argument(sym1)
           << setw(11) << "-"
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym3);
         break;
     case q_iuminus:
         o << setw(11) << "q_iuminus"
-          << setw(11) << sym_tab->get_symbol(sym1)
+          << setw(11) << quad_argument(sym1)
           << setw(11) << "-"
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym3);
         break;
     case q_rplus:
         o << setw(11) << "q_rplus"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_iplus:
         o << setw(11) << "q_iplus"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_rminus:
         o << setw(11) << "q_rminus"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_iminus:
         o << setw(11) << "q_iminus"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_ior:
         o << setw(11) << "q_ior"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_iand:
         o << setw(11) << "q_iand"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_rmult:
         o << setw(11) << "q_rmult"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_imult:
         o << setw(11) << "q_imult"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_rdivide:
         o << setw(11) << "q_rdivide"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_idivide:
         o << setw(11) << "q_idivide"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_imod:
         o << setw(11) << "q_imod"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_req:
         o << setw(11) << "q_req"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_ieq:
         o << setw(11) << "q_ieq"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_rne:
         o << setw(11) << "q_rne"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_ine:
         o << setw(11) << "q_ine"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_rlt:
         o << setw(11) << "q_rlt"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_ilt:
         o << setw(11) << "q_ilt"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_rgt:
         o << setw(11) << "q_rgt"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_igt:
         o << setw(11) << "q_igt"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_rstore:
         o << setw(11) << "q_rstore"
-          << setw(11) << sym_tab->get_symbol(sym1)
+          << setw(11) << quad_argument(sym1)
           << setw(11) << "-"
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym3);
         break;
     case q_istore:
         o << setw(11) << "q_istore"
-          << setw(11) << sym_tab->get_symbol(sym1)
+          << setw(11) << quad_argument(sym1)
           << setw(11) << "-"
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym3);
         break;
     case q_rassign:
         o << setw(11) << "q_rassign"
-          << setw(11) << sym_tab->get_symbol(sym1)
+          << setw(11) << quad_argument(sym1)
           << setw(11) << "-"
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym3);
         break;
     case q_iassign:
         o << setw(11) << "q_iassign"
-          << setw(11) << sym_tab->get_symbol(sym1)
+          << setw(11) << quad_argument(sym1)
           << setw(11) << "-"
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym3);
         break;
     case q_call:
         o << setw(11) << "q_call"
-          << setw(11) << sym_tab->get_symbol(sym1)
+          << setw(11) << quad_argument(sym1)
           << setw(11) << int2
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym3);
         break;
     case q_rreturn:
         o << setw(11) << "q_rreturn"
           << setw(11) << int1
-          << setw(11) << sym_tab->get_symbol(sym2)
+          << setw(11) << quad_argument(sym2, immediate)
           << setw(11) << "-";
         break;
     case q_ireturn:
         o << setw(11) << "q_ireturn"
           << setw(11) << int1
-          << setw(11) << sym_tab->get_symbol(sym2)
+          << setw(11) << quad_argument(sym2, immediate)
           << setw(11) << "-";
         break;
     case q_lindex:
         o << setw(11) << "q_lindex"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_rrindex:
         o << setw(11) << "q_rrindex"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_irindex:
         o << setw(11) << "q_irindex"
-          << setw(11) << sym_tab->get_symbol(sym1)
-          << setw(11) << sym_tab->get_symbol(sym2)
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym1)
+          << setw(11) << quad_argument(sym2, immediate)
+          << setw(11) << quad_argument(sym3);
         break;
     case q_itor:
         o << setw(11) << "q_itor"
-          << setw(11) << sym_tab->get_symbol(sym1)
+          << setw(11) << quad_argument(sym1)
           << setw(11) << "-"
-          << setw(11) << sym_tab->get_symbol(sym3);
+          << setw(11) << quad_argument(sym3);
         break;
     case q_jmp:
         o << setw(11) << "q_jmp"
@@ -899,12 +1156,12 @@ void quadruple::print(ostream &o)
     case q_jmpf:
         o << setw(11) << "q_jmpf"
           << setw(11) << int1
-          << setw(11) << sym_tab->get_symbol(sym2)
+          << setw(11) << quad_argument(sym2, immediate)
           << setw(11) << "-";
         break;
     case q_param:
         o << setw(11) << "q_param"
-          << setw(11) << sym_tab->get_symbol(sym1)
+          << setw(11) << quad_argument(sym1)
           << setw(11) << "-"
           << setw(11) << "-";
         break;
@@ -929,16 +1186,10 @@ void quadruple::print(ostream &o)
 
 void quad_list::print(ostream &o)
 {
-    quad_list_element *e;
-
     o << short_symbols;
 
-    quad_nr = 1;
-    e = head;
-    while (e != NULL) {
-        o << setw(5) << quad_nr << e->data << endl;
-        e = e->next;
-        quad_nr++;
+    for (long i = 0; i < quad_count; i++) {
+        o << setw(5) << i + 1 << &quads[i] << endl;
     }
 
     o << long_symbols;
@@ -54,60 +54,96 @@ typedef enum {
 } quad_op_type;
 
 
+// Initial number of quads a quad_list has room for.
+const long BASE_QUAD_CAPACITY = 64;
+
+
 class quad_list;
 
 /* The quadruple class. A quadruple is a pseudo-assembler op-code with three
    arguments (more correctly, two arguments and one result), which depend on
    the op_code of the quad. To create a quad with a '-' argument (ie, not used),
-   set the sym_index value to NULL_SYM for that quad. See above. */
+   set the sym_index value to NULL_SYM for that quad. See above.
+
+   The second argument of the integer quads taking two values (arithmetic
+   and relations), of the index quads and of q_ireturn may be an immediate
+   instead, a constant in int2, which the quad optimizer puts there in place
+   of temporaries holding constants. The immediate flag tells which it is.
+
+   Quads are stored by value in a quad_list, so they are kept small: each
+   argument is either a symbol or an integer, never both, so the two names
+   share storage. Only the first argument ever needs 64 bits (for the
+   constants of q_iload and q_rload); the other two are labels, counts,
+   symbols, temporaries or immediates, all of which fit in an int. This
+   makes a quad 24 bytes. */
 class quadruple
 {
 private:
     void print(ostream &);
 
 public:
+    union {
+        sym_index sym1;
+        long int1;
+    };
+    union {
+        int sym2;
+        int int2;
+    };
+    union {
+        int sym3;
+        int int3;
+    };
+
     quad_op_type op_code;
-    // NOTE: Get rid of the ones we won't need later... int3?
-    sym_index sym1;
-    sym_index sym2;
-    sym_index sym3;
 
-    long int1;
-    long int2;
-    long int3;
+    // True if argument 2 is an immediate in int2 rather than a symbol.
+    bool immediate;
 
     // As sym_index has type long, and we need integers of type long
     // we abuse the weak type system. This should be changed back to
     // separate overloaded constructors once C++ supports
     // strong typedefs (or the datatype of either changes).
-    // This also means that for now we're setting both intN and symN
-    // to maintain the API.
     quadruple(quad_op_type, sym_index, sym_index, sym_index);
-    //quadruple(quad_op_type, long, sym_index, sym_index);
-    //quadruple(quad_op_type, sym_index, long, sym_index);
 
-    friend ostream &operator<<(ostream &, quadruple *);
-};
+    // A q_nop quad. Only used to fill unused space in a quad_list.
+    quadruple();
 
+    // Return true if argument nr 1, 2 or 3 is a symbol or temporary whose
+    // value the quad reads. An array argument isn't read, only indexed, and
+    // an immediate isn't a symbol.
+    bool reads(const int);
 
-/* This class is simply an abstraction to prevent quads from having to
-   contain a link to the next quad, which is a representation issue having
-   nothing to do with the program it represents. */
-class quad_list_element
-{
-public:
-    quadruple         *data;
-    quad_list_element *next;
+    // Return the symbol or temporary the quad assigns a value to, or
+    // NULL_SYM if there is none. q_istore and q_rstore write to memory
+    // through an address, not to a symbol.
+    sym_index writes();
+
+    // Get or set argument nr 1, 2 or 3 as a sym_index.
+    sym_index get_arg(const int);
+    void set_arg(const int, const sym_index);
 
-    quad_list_element(quadruple *, quad_list_element *);
+    // Return true if argument 2 may be an immediate.
+    bool takes_immediate();
+
+    // Make argument 2 an immediate. Arg: the constant, which must fit in an
+    // int.
+    void set_immediate(const long);
+
+    friend ostream &operator<<(ostream &, quadruple *);
 };
 
 
 
-/* This class lets us iterate over a quad_list in a convenient fashion. */
+/* This class lets us iterate over a quad_list in a convenient fashion. It is
+   just a position in the list, so it is cheap to create and to copy. The
+   quad pointers it hands out are only valid until the list grows. */
 class quad_list_iterator
 {
-    quad_list_element *current;
+    quad_list *list;
+
+    // Index of the current quad.
+    long current;
 
 public:
     quad_list_iterator(quad_list *q_list);
@@ -124,18 +160,20 @@ public:
 /* A list of quads. This list will eventually contain the entire program in
    quad operations. Or at least entire blocks at a time. Had we represented
    the entire program as an AST, the list would have contained the whole
-   program, but since we don't, it doesn't. :-) */
+   program, but since we don't, it doesn't. :-)
+   The quads are kept in one contiguous array, in order, so they can be
+   addressed by index and a pass over them touches memory sequentially. */
 class quad_list
 {
 private:
-    // Pointer to the first list element.
-    quad_list_element *head;
+    // The quads.
+    quadruple *quads;
 
-    // Pointer to the rest of the elements.
-    quad_list_element *tail;
+    // Number of quads in the list.
+    long quad_count;
 
-    // Used to get nice printouts.
-    int quad_nr;
+    // Number of quads there is room for.
+    long capacity;
 
      // Used to get nice printouts.
     void print(ostream &);
@@ -147,8 +185,16 @@ public:
     // Constructor. Arg == last_label.
     quad_list(int);
 
+    ~quad_list();
+
     // Add on a new quad last on the list.
-    quad_list &operator+=(quadruple *q);
+    quad_list &operator+=(const quadruple &q);
+
+    // Number of quads in the list.
+    long size();
+
+    // The quad at a given index, counting from 0.
+    quadruple &operator[](const long);
 
     // Allow the iterator access to private data fields in this class.
     friend class quad_list_iterator;
@@ -5,13 +5,20 @@
  ***************************************/
 
 
-/* Symbol superclass constructor. */
-symbol::symbol(pool_index pool_p)
+/* Symbol superclass constructor. The kind is given by the constructor of
+   the subclass being created. */
+symbol::symbol(pool_index pool_p, sym_type sym_kind)
 {
     id = pool_p;
     // All symbols are tagged as SYM_UNDEF at creation.
     // This is used later to check for redeclarations.
     tag = SYM_UNDEF;
+    kind = sym_kind;
+    type = void_type;
+    hash_link = NULL_SYM;
+    back_link = 0;
+    level = 0;
+    offset = 0;
 }
 
 
@@ -22,7 +29,7 @@ symbol::symbol(pool_index pool_p)
    will be used a lot in this lab course, so you might as well get used
    to it right away, even if it is new to you. */
 constant_symbol::constant_symbol(const pool_index pool_p) :
-    symbol(pool_p)
+    symbol(pool_p, SYM_CONST)
 {
     // Since the const_value is a union of int and float (since a constant can
     // be both integer and real), we just pick one of them arbitrarily and
@@ -34,14 +41,15 @@ constant_symbol::constant_symbol(const pool_index pool_p) :
 /* Constructor for variable_symbol. */
 /* NOTE: Maybe always set the type to void_type here, too? */
 variable_symbol::variable_symbol(const pool_index pool_p) :
-    symbol(pool_p)
+    symbol(pool_p, SYM_VAR)
 {
+    reg = NO_REGISTER;
 }
 
 
 /* Constructor for array_symbol. */
 array_symbol::array_symbol(const pool_index pool_p) :
-    symbol(pool_p)
+    symbol(pool_p, SYM_ARRAY)
 {
     // Illegal, must be changed later.
     index_type = void_type;
@@ -51,7 +59,7 @@ array_symbol::array_symbol(const pool_index pool_p) :
 
 /* Constructor for parameter_symbol. */
 parameter_symbol::parameter_symbol(const pool_index pool_p) :
-    symbol(pool_p)
+    symbol(pool_p, SYM_PARAM)
 {
     size = 0;
     preceding = NULL;
@@ -60,7 +68,7 @@ parameter_symbol::parameter_symbol(const pool_index pool_p) :
 
 /* Constructor for procedure_symbol. */
 procedure_symbol::procedure_symbol(const pool_index pool_p) :
-    symbol(pool_p)
+    symbol(pool_p, SYM_PROC)
 {
     ar_size = 0;
     label_nr = 0;
@@ -70,7 +78,7 @@ procedure_symbol::procedure_symbol(const pool_index pool_p) :
 
 /* Constructor for function_symbol. */
 function_symbol::function_symbol(const pool_index pool_p) :
-    symbol(pool_p)
+    symbol(pool_p, SYM_FUNC)
 {
     ar_size = 0;
     label_nr = 0;
@@ -80,13 +88,77 @@ function_symbol::function_symbol(const pool_index pool_p) :
 
 /* Constructor for nametype_symbol. */
 nametype_symbol::nametype_symbol(const pool_index pool_p) :
-    symbol(pool_p)
+    symbol(pool_p, SYM_NAMETYPE)
 {
 }
 
 
 
 
+/*** Downcasting from symbol to its subclasses ***/
+
+/* These check the kind of the symbol before casting it, so that a symbol is
+   never treated as something it's not. */
+
+constant_symbol *symbol::get_constant_symbol()
+{
+    if (kind != SYM_CONST) {
+        fatal("Illegal downcasting to constant from symbol class");
+    }
+    return static_cast<constant_symbol *>(this);
+}
+
+variable_symbol *symbol::get_variable_symbol()
+{
+    if (kind != SYM_VAR) {
+        fatal("Illegal downcasting to variable from symbol class");
+    }
+    return static_cast<variable_symbol *>(this);
+}
+
+array_symbol *symbol::get_array_symbol()
+{
+    if (kind != SYM_ARRAY) {
+        fatal("Illegal downcasting to array from symbol class");
+    }
+    return static_cast<array_symbol *>(this);
+}
+
+parameter_symbol *symbol::get_parameter_symbol()
+{
+    if (kind != SYM_PARAM) {
+        fatal("Illegal downcasting to parameter from symbol class");
+    }
+    return static_cast<parameter_symbol *>(this);
+}
+
+procedure_symbol *symbol::get_procedure_symbol()
+{
+    if (kind != SYM_PROC) {
+        fatal("Illegal downcasting to procedure from symbol class");
+    }
+    return static_cast<procedure_symbol *>(this);
+}
+
+function_symbol *symbol::get_function_symbol()
+{
+    if (kind != SYM_FUNC) {
+        fatal("Illegal downcasting to function from symbol class");
+    }
+    return static_cast<function_symbol *>(this);
+}
+
+nametype_symbol *symbol::get_nametype_symbol()
+{
+    if (kind != SYM_NAMETYPE) {
+        fatal("Illegal downcasting to nametype from symbol class");
+    }
+    return static_cast<nametype_symbol *>(this);
+}
+
+
+
+
 /*** Functions for printing symbol information ***/
 
 // This is the default detail level of information given when printing a
@@ -101,7 +173,7 @@ void symbol::print(ostream &o)
     switch (output_format) {
     case LONG_FORMAT:
         o << "symbol:" << endl;
-        o << "  id:        " << sym_tab->pool_lookup(id) << endl;
+        o << "  id:        " << sym_tab->pool_view(id) << endl;
         o << "  type:      " << short_symbols
           << sym_tab->get_symbol(type) << long_symbols << endl;
         o << "  level:     " << level << endl;
@@ -164,10 +236,10 @@ void symbol::print(ostream &o)
             o << "(SYM_NAMETYPE) ";
             break;
         }
-        o << sym_tab->pool_lookup(id);
+        o << sym_tab->pool_view(id);
         break;
     case SHORT_FORMAT:
-        o << sym_tab->pool_lookup(id);
+        o << sym_tab->pool_view(id);
         break;
     default:
         fatal("Bad output format in symbol::print()");
@@ -183,7 +255,34 @@ ostream &operator<<(ostream &o, symbol *sym)
         return o << "(null)" << endl;
     }
 
-    sym->print(o);
+    // Call the print method of the symbol's subclass. It is picked by hand
+    // since the print methods aren't virtual.
+    switch (sym->kind) {
+    case SYM_CONST:
+        sym->get_constant_symbol()->print(o);
+        break;
+    case SYM_VAR:
+        sym->get_variable_symbol()->print(o);
+        break;
+    case SYM_ARRAY:
+        sym->get_array_symbol()->print(o);
+        break;
+    case SYM_PARAM:
+        sym->get_parameter_symbol()->print(o);
+        break;
+    case SYM_PROC:
+        sym->get_procedure_symbol()->print(o);
+        break;
+    case SYM_FUNC:
+        sym->get_function_symbol()->print(o);
+        break;
+    case SYM_NAMETYPE:
+        sym->get_nametype_symbol()->print(o);
+        break;
+    default:
+        sym->print(o);
+        break;
+    }
     return o;
 }
 
@@ -269,11 +368,11 @@ void parameter_symbol::print(ostream &o)
         if (preceding == NULL) {
             o << "  preceding: NULL" << endl;
         } else
-            o << "  preceding: " << sym_tab->pool_lookup(preceding->id)
+            o << "  preceding: " << sym_tab->pool_view(preceding->id)
               << endl;
         break;
     case SUMMARY_FORMAT:
-        o << " <-- " << sym_tab->pool_lookup(preceding->id);
+        o << " <-- " << sym_tab->pool_view(preceding->id);
         break;
     case SHORT_FORMAT:
         break;
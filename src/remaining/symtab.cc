@@ -6,6 +6,8 @@
 #include <iostream>
 #include <ctype.h>
 #include <string.h>
+#include <new>
+#include <algorithm>
 #include "symtab.hh"
 
 using namespace std;
@@ -18,7 +20,76 @@ sym_index void_type;
 sym_index integer_type;
 sym_index real_type;
 
-static unsigned temporary_variables = 0;
+/*** The symbol_storage class ***/
+
+/* Constructor: starts out with an empty chunk directory. Chunks are only
+   allocated once symbols are entered into them. Every slot is big enough
+   to hold any kind of symbol. */
+symbol_storage::symbol_storage()
+{
+	slot_size = sizeof(constant_symbol);
+	slot_size = max(slot_size, sizeof(variable_symbol));
+	slot_size = max(slot_size, sizeof(array_symbol));
+	slot_size = max(slot_size, sizeof(parameter_symbol));
+	slot_size = max(slot_size, sizeof(procedure_symbol));
+	slot_size = max(slot_size, sizeof(function_symbol));
+	slot_size = max(slot_size, sizeof(nametype_symbol));
+
+	directory_size = BASE_SYM_CHUNKS;
+	chunk_count = 0;
+	chunks = new char*[directory_size];
+}
+
+
+/* Allocate chunks until there is one holding index i, and return the slot
+   for that index. Only the directory is ever copied when it grows, never the
+   chunks it points to. */
+void *symbol_storage::reserve(const sym_index i)
+{
+	assert(i >= 0);
+
+	while (i >= chunk_count * SYM_CHUNK_SIZE) {
+		if (chunk_count == directory_size) {
+			char **tmp_chunks = new char*[2 * directory_size];
+			memcpy(tmp_chunks, chunks, directory_size * sizeof(char *));
+			delete[] chunks;
+			chunks = tmp_chunks;
+			directory_size *= 2;
+		}
+
+		// The memory returned by new is suitably aligned for any symbol, and
+		// slot_size is a multiple of the alignment since it's a sizeof.
+		chunks[chunk_count++] = new char[SYM_CHUNK_SIZE * slot_size];
+	}
+
+	return &chunks[i / SYM_CHUNK_SIZE][(i & (SYM_CHUNK_SIZE - 1)) * slot_size];
+}
+
+
+/* Return the symbol at index i. The chunk is found by the high bits of i and
+   the slot within it by the low bits. */
+symbol *symbol_storage::operator[](const sym_index i)
+{
+	// Catch references to symbols that were never reserved.
+	assert(i >= 0 && i < chunk_count * SYM_CHUNK_SIZE);
+
+	return (symbol *)
+		&chunks[i / SYM_CHUNK_SIZE][(i & (SYM_CHUNK_SIZE - 1)) * slot_size];
+}
+
+
+/* Free the chunks past the one holding index last. One spare chunk is kept,
+   so that a scope straddling a chunk boundary doesn't allocate and free the
+   same chunk over and over again. */
+void symbol_storage::release(const sym_index last)
+{
+	long needed = last / SYM_CHUNK_SIZE + 2;
+	while (chunk_count > needed) {
+		delete[] chunks[--chunk_count];
+	}
+}
+
+
 
 /*** The symbol_table class - watch out, it's big. ***/
 
@@ -44,9 +115,19 @@ symbol_table::symbol_table()
 	string_pool = new char[pool_length];
 	string_pool[0] = '\0';
 
+	// --- Initialize string interning table. ---
+	intern_size = BASE_INTERN_SIZE;
+	intern_count = 0;
+	intern_table = new pool_index[intern_size];
+	for (long i = 0; i < intern_size; i++) {
+		intern_table[i] = -1;
+	}
+
 	// --- Initialize hash table. ---
-	hash_table = new sym_index[MAX_HASH];
-	for (int i = 0; i < MAX_HASH; i++) {
+	hash_size = BASE_HASH_SIZE;
+	hash_count = 0;
+	hash_table = new sym_index[hash_size];
+	for (hash_index i = 0; i < hash_size; i++) {
 		hash_table[i] = NULL_SYM;
 	}
 
@@ -54,20 +135,20 @@ symbol_table::symbol_table()
 	// The block_table will keep track of the current lexical level
 	// global level is 0
 	current_level = 0;
-	block_table = new sym_index[MAX_BLOCK];
-	for (int i = 0; i < MAX_BLOCK; i++) {
+	block_table = new sym_index[MAX_BLOCK + 1];
+	pool_table = new long[MAX_BLOCK + 1];
+	for (int i = 0; i <= MAX_BLOCK; i++) {
 		block_table[i] = 0;
+		pool_table[i] = 0;
 	}
 
 	// --- Initialize symbol table. ---
-	// Weird syntax, gives us a table of pointers to symbols.
-	sym_table = new symbol*[MAX_SYM];
-	for (int i = 0; i < MAX_SYM; i++) {
-		sym_table[i] = NULL;
-	}
+	// The sym_table takes care of itself, see symbol_storage.
 
 	label_nr = -1;
 	temp_nr = 0;
+	temp_size = BASE_TEMP_SIZE;
+	temp_table = new temp_info[temp_size];
 	// sym_pos will point to the last entry in symbol table
 	sym_pos = -1;
 
@@ -83,7 +164,7 @@ symbol_table::symbol_table()
 	position_information *dummy_pos = new position_information();
 
 	// This "empty" symbol represents the global level.
-	enter_procedure(dummy_pos, pool_install(capitalize("global.")));
+	enter_procedure(dummy_pos, pool_install_identifier("global."));
 	// Needed since there have been no types installed yet.
 	sym_table[0]->type = void_type;
 
@@ -91,16 +172,16 @@ symbol_table::symbol_table()
 	// is used, since currently Diesel's grammar doesn't handle used-defined
 	// types.
 
-	void_type = enter_nametype(dummy_pos, pool_install(capitalize("void")));
+	void_type = enter_nametype(dummy_pos, pool_install_identifier("void"));
 	sym_table[void_type]->type = void_type; // Needed since it's the first one.
 
-	integer_type = enter_nametype(dummy_pos, pool_install(capitalize("integer")));
+	integer_type = enter_nametype(dummy_pos, pool_install_identifier("integer"));
 
-	real_type = enter_nametype(dummy_pos, pool_install(capitalize("real")));
+	real_type = enter_nametype(dummy_pos, pool_install_identifier("real"));
 
 	{
 		// Add the read() function. It returns an integer and takes no arguments.
-		sym_index read_sym = enter_function(dummy_pos, pool_install(capitalize("read")));
+		sym_index read_sym = enter_function(dummy_pos, pool_install_identifier("read"));
 		sym_table[read_sym]->type = integer_type;
 	}
 	{
@@ -109,9 +190,9 @@ symbol_table::symbol_table()
 		// environment doesn't work exactly like a normal scope. To do this
 		// we're forced to do some safe downcasting (the get_foo_symbol() calls).
 		// We do that to get hold of the correct subclass of symbol.
-		sym_index write_sym = enter_procedure(dummy_pos, pool_install(capitalize("write")));
+		sym_index write_sym = enter_procedure(dummy_pos, pool_install_identifier("write"));
 		sym_index int_arg = enter_parameter(dummy_pos,
-				pool_install(capitalize("int-arg")),
+				pool_install_identifier("int-arg"),
 				integer_type);
 		procedure_symbol *proc = sym_table[write_sym]->get_procedure_symbol();
 		proc->last_parameter = sym_table[int_arg]->get_parameter_symbol();
@@ -119,7 +200,7 @@ symbol_table::symbol_table()
 
 	// Add the trunc(real-arg) function. It returns an integer and takes
 	// a real argument.
-	sym_index trunc_sym = enter_function(dummy_pos, pool_install(capitalize("trunc")));
+	sym_index trunc_sym = enter_function(dummy_pos, pool_install_identifier("trunc"));
 	symbol *truc = sym_table[trunc_sym];
 	truc->type = integer_type;
 
@@ -127,7 +208,7 @@ symbol_table::symbol_table()
 	// enter_parameter. This is very handy everywhere in this compiler except
 	// just here. So this workaround is unfortunately needed.
 	sym_index real_arg = enter_parameter(dummy_pos,
-			pool_install(capitalize("real-arg")),
+			pool_install_identifier("real-arg"),
 			real_type);
 
 	parameter_symbol *par = sym_table[real_arg]->get_parameter_symbol();
@@ -165,31 +246,72 @@ long symbol_table::get_next_label()
 }
 
 
-/* Generate a unique temporary variable name. We do it without any extra fuss:
-   $1, $2, $3, $4 ... up to 1 million. Diesel isn't written to handle that
-   large programs anyway. The type should never be void_type; if it is, it's
-   an error. This method is used for quad generation. */
+/* Generate a new temporary variable. Temporaries are not entered into the
+   symbol table and have no names, they are just numbered, starting over for
+   each block. Each one is given a slot in the activation record of the
+   current block. The type should never be void_type; if it is, it's an
+   error. This method is used for quad generation. */
 sym_index symbol_table::gen_temp_var(sym_index type)
 {
-
 	if (type == void_type) {
-    fatal("Fatal, not allowed to generate temporary variable of void type");
-    return -2;
-  }
+		fatal("Fatal, not allowed to generate temporary variable of void type");
+		return NULL_SYM;
+	}
+
+	// Grow the table of temporaries geometrically when it's full.
+	if (temp_nr == temp_size) {
+		temp_info *tmp_table = new temp_info[2 * temp_size];
+		memcpy(tmp_table, temp_table, temp_size * sizeof(temp_info));
+		delete[] temp_table;
+		temp_table = tmp_table;
+		temp_size *= 2;
+	}
+
+	temp_info *temp = &temp_table[temp_nr];
+	temp->type = type;
+	temp->level = current_level;
+	temp->reg = NO_REGISTER;
+
+	// Allocate the temporary in the activation record of the current block,
+	// just like a local variable.
+	symbol *env = sym_table[current_environment()];
+	if (env->tag == SYM_FUNC) {
+		function_symbol *cur_func = env->get_function_symbol();
+		temp->offset = cur_func->ar_size;
+		cur_func->ar_size += get_size(type);
+	} else {
+		procedure_symbol *cur_proc = env->get_procedure_symbol();
+		temp->offset = cur_proc->ar_size;
+		cur_proc->ar_size += get_size(type);
+	}
+
+	return TEMP_BASE + temp_nr++;
+}
+
+
+/* Forget all temporaries generated so far. The quads of a block have been
+   expanded to assembler by the time the next block is handled, so the
+   numbers can be reused from there on. */
+void symbol_table::reset_temps()
+{
+	temp_nr = 0;
+}
 
-  // not allowed with to many temporary variables
-  if (temporary_variables > 1000000) {
-    fatal("It is not allowed to use more than 1 million temporary variables");
-    return -3;
-  }
 
-  // set a string to $N where N is the number or temporary variables
-  // install the new variable
-  char *temp = new char[9];
-  sprintf(temp, "$%d", temporary_variables++);
-  pool_index p_index = pool_install(temp);
-  position_information *pos = new position_information(0,0);
-	return enter_variable(pos,p_index,type);
+/* Return true if a sym_index refers to a temporary variable. */
+bool symbol_table::is_temp(const sym_index sym_p)
+{
+	return sym_p >= TEMP_BASE;
+}
+
+
+/* Return the information about a temporary variable given its sym_index. */
+temp_info *symbol_table::get_temp(const sym_index sym_p)
+{
+	// Catch references to temporaries that don't exist (any more).
+	assert(is_temp(sym_p) && sym_p - TEMP_BASE < temp_nr);
+
+	return &temp_table[sym_p - TEMP_BASE];
 }
 
 
@@ -229,19 +351,17 @@ void symbol_table::print(int detail)
 {
 	if (detail == 2) {
 		if (pool_pos > 0) {
-			unsigned int pos = 0;
-			while (pos < strlen(string_pool)) {
-				unsigned int len = (int) string_pool[pos];
-				cout << len;
-				for (unsigned int k = pos + 1; k < pos + len + 1; k++) {
-					cout << string_pool[k];
-				}
-				pos += len + 1;
+			// The hash values in the entry headers aren't printed.
+			ostringstream strings;
+			long pos = 0;
+			while (pos < pool_pos) {
+				pool_string s = pool_view(pos);
+				strings << s.length << s;
+				pos += POOL_HEADER_SIZE + s.length;
 			}
-			cout << endl;
+			cout << strings.str() << endl;
 
-			// cout << string_pool << endl;
-			for (int j = 0; j < pool_pos; j++) {
+			for (unsigned long j = 0; j < strings.str().length(); j++) {
 				cout << "-";
 			}
 			cout << "^" << " (pool_pos = " << pool_pos << ")" << endl;
@@ -253,7 +373,7 @@ void symbol_table::print(int detail)
 
 	if (detail == 3) {
 		cout << "Hash table:\n";
-		for (int j = 0; j < MAX_HASH; j++) {
+		for (hash_index j = 0; j < hash_size; j++) {
 			if (hash_table[j]) {
 				cout << j << ": " << hash_table[j] << endl;
 			}
@@ -279,7 +399,7 @@ void symbol_table::print(int detail)
 
 				cout << setw(3) << i << ": ";
 				cout.flags(ios::left);
-				cout << setw(12) << pool_lookup(tmp->id);
+				cout << setw(12) << pool_view(tmp->id);
 				cout.flags(ios::right);
 				cout << tmp->level
 					<< setw(5) << tmp->hash_link << setw(5)
@@ -287,7 +407,7 @@ void symbol_table::print(int detail)
 
 				cout.flags(ios::left);
 				cout << setw(10);
-				cout << pool_lookup(sym_table[tmp->type]->id);
+				cout << pool_view(sym_table[tmp->type]->id);
 				cout << setw(14);
 				switch (tmp->tag) {
 					case SYM_UNDEF:
@@ -305,7 +425,7 @@ void symbol_table::print(int detail)
 										if (par->preceding != NULL) {
 											cout << setw(7) << "prec = "
 												<< setw(12) <<
-												pool_lookup(par->preceding->id);
+												pool_view(par->preceding->id);
 										}
 										break;
 									}
@@ -380,10 +500,12 @@ char *symbol_table::capitalize(const char *s)
 }
 
 /* Install a string into the pool table and return its index.
-   The table is on the form <string1 length>string1<string2 length>string2...
-   Note that the null char denotes the end of the entire pool,
+   The table is on the form <string1 length><hash1>string1<string2 length>
+   <hash2>string2... where each hash is the 4 bytes of the string's hash_x33
+   value. Note that the null char denotes the end of the entire pool,
    NOT the separator of two strings. It is appended in pool_lookup, though.
-Snapshot:
+   Use pool_view() to get at the string without copying it.
+Snapshot (without the hash values):
 7INTEGER4REAL4READ5WRITE4PROG1A\0
 ^
 pool_pos
@@ -391,67 +513,185 @@ pool_pos
 
 pool_index symbol_table::pool_install(char *s)
 {
-	// Make sure pool is not full. If it is, double pool size.
-	if (pool_pos + (int) strlen(s) >= pool_length) {
-		char *tmp_pool = new char[2 * pool_length];
+	long len = strlen(s);
+	// The hash value is only ever calculated here. Everything else uses
+	// the copy stored in the entry header.
+	unsigned int h = hash_x33(s, len);
+
+	// Each distinct string is only stored once. If it has been installed
+	// before, hand out the index of the earlier copy.
+	long slot = intern_slot(s, len, h);
+	if (intern_table[slot] != -1) {
+		return intern_table[slot];
+	}
 
-		// Double pool size.
-		pool_length *= 2;
-		strcpy(tmp_pool, string_pool);
+	// This is not really a pretty solution but it works for now. Some sort
+	// struct with length/char * would be a more general solution, since this
+	// way we're limited to strings that fit within 255 bytes.
+	if (len >= 255) {
+		fatal("symbol_table::pool_install: Too long string");
+		return 0;
+	}
+
+	// Make sure the entry (header, string and the terminating null char)
+	// fits. If it doesn't, grow the pool geometrically so that installing n
+	// strings costs O(n) copying in total.
+	long entry_size = POOL_HEADER_SIZE + len + 1;
+	if (pool_pos + entry_size > pool_length) {
+		long new_length = pool_length;
+		while (pool_pos + entry_size > new_length) {
+			new_length *= 2;
+		}
+		char *tmp_pool = new char[new_length];
+
+		// Only the used part of the pool (and its null char) needs copying.
+		memcpy(tmp_pool, string_pool, pool_pos + 1);
 		delete[] string_pool;
 		string_pool = tmp_pool;
+		pool_length = new_length;
 	}
 
 	// The return value, ie, the start of the string.
 	long old_pos = pool_pos;
 
-	// This is not really a pretty solution but it works for now. Some sort
-	// struct with length/char * would be a more general solution, since this
-	// way we're limited to strings that fit within 255 bytes.
-	if (strlen(s) >= 255) {
-		fatal("symbol_table::pool_install: Too long string");
+	// First install the length of the string, and remember its hash value.
+	// The hash may be unaligned, so it is copied byte by byte.
+	string_pool[pool_pos] = (unsigned char) len;
+	memcpy(&string_pool[pool_pos + POOL_LENGTH_SIZE], &h, sizeof(h));
+	pool_pos += POOL_HEADER_SIZE;
+
+	// Add the string itself to the end of the pool. We know where the end is,
+	// so there is no need to let strcat() search for it.
+	memcpy(&string_pool[pool_pos], s, len);
+
+	// Move pool_pos to the end of the new entry and terminate the pool.
+	pool_pos += len;
+	string_pool[pool_pos] = '\0';
+
+	// Remember the new string. Keep the table at most half full so that
+	// probe sequences stay short.
+	intern_table[slot] = old_pos;
+	if (++intern_count * 2 > intern_size) {
+		intern_rehash(2 * intern_size);
+	}
+
+	return old_pos;
+}
+
+
+/* Install an identifier in the pool. Identifiers are case insensitive, so
+   they are stored capitalized. Unlike pool_install(capitalize(s)) this
+   doesn't leave a heap allocated copy behind for every scanned identifier. */
+
+pool_index symbol_table::pool_install_identifier(const char *s)
+{
+	// pool_install() can't take longer strings than this anyway.
+	char capitalized_s[256];
+	long len = strlen(s);
+
+	if (len >= 255) {
+		fatal("symbol_table::pool_install_identifier: Too long identifier");
 		return 0;
 	}
 
-	// First install the length of the string.
-	string_pool[pool_pos++] = (unsigned char) strlen(s);
-	string_pool[pool_pos] = '\0';
+	for (long i = 0; i < len; i++) {
+		capitalized_s[i] = (unsigned char) toupper(s[i]);
+	}
+	capitalized_s[len] = '\0';
 
-	// Add the string itself to the end of the pool.
-	strcat(string_pool, s);
+	return pool_install(capitalized_s);
+}
 
-	// Move pool_pos to the end of the new entry.
-	pool_pos += strlen(s);
 
-	return old_pos;
+/* Return the intern_table slot holding the pool_index of the string s of
+   length len and hash value h, or the first free slot in its probe sequence
+   if s is not in the pool. Collisions are resolved by linear probing. The
+   stored hash values are compared first, so the characters are only looked
+   at when the string is almost certainly a match. */
+
+long symbol_table::intern_slot(const char *s, const long len,
+		const unsigned int h)
+{
+	long mask = intern_size - 1;
+	long slot = h & mask;
+	while (intern_table[slot] != -1) {
+		pool_index p = intern_table[slot];
+		if (pool_hash(p) == h &&
+				(unsigned char) string_pool[p] == len &&
+				memcmp(&string_pool[p + POOL_HEADER_SIZE], s, len) == 0) {
+			break;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return slot;
 }
 
 
-/* Allocate memory for and return a string given a pool_index. */
+/* Give the interning table new_size slots, re-entering every string in it
+   that is still part of the pool. Strings beyond pool_pos are dropped, which
+   is how the table keeps up with pool_forget() and release_scope(). */
 
-char *symbol_table::pool_lookup(const pool_index p)
+void symbol_table::intern_rehash(const long new_size)
+{
+	pool_index *old_table = intern_table;
+	long old_size = intern_size;
+
+	intern_size = new_size;
+	intern_count = 0;
+	intern_table = new pool_index[intern_size];
+	for (long i = 0; i < intern_size; i++) {
+		intern_table[i] = -1;
+	}
+
+	for (long i = 0; i < old_size; i++) {
+		pool_index p = old_table[i];
+		if (p != -1 && p < pool_pos) {
+			long slot = intern_slot(&string_pool[p + POOL_HEADER_SIZE],
+					(unsigned char) string_pool[p],
+					pool_hash(p));
+			intern_table[slot] = p;
+			intern_count++;
+		}
+	}
+	delete[] old_table;
+}
+
+
+/* Return a view of a string given a pool_index. This is what should be used
+   on hot paths and for printing, since it just points into the pool. */
+
+pool_string symbol_table::pool_view(const pool_index p)
 {
 	// Catch references to beyond last string.
 	assert(p < pool_pos);
 
-	// Start points to first char of the sought string.
-	// We just use it to index the pool, it is never assigned to.
-	char *start = &string_pool[p + 1];
+	pool_string s;
+	// p points to the char holding the length of the sought string, which
+	// is followed by its hash value.
+	s.length = (unsigned char) string_pool[p];
+	s.chars = &string_pool[p + POOL_HEADER_SIZE];
+	return s;
+}
+
+
+/* Allocate memory for and return a string given a pool_index. */
 
-	// p points to the char holding the length of the sought string.
-	int length = (int) string_pool[p];
+char *symbol_table::pool_lookup(const pool_index p)
+{
+	pool_string view = pool_view(p);
 
 	// We only want to return a string of length chars, plus
 	// one extra for the null terminator.
-	char *s = new char[length + 1];
-	strncpy(s, start, length);
-	s[length] = '\0';
+	char *s = new char[view.length + 1];
+	memcpy(s, view.chars, view.length);
+	s[view.length] = '\0';
 
 	return s;
 }
 
 
-/* Compare two strings. */
+/* Compare two strings. The lengths are compared first, which settles most
+   unequal pairs without looking at the characters at all. */
 
 bool symbol_table::pool_compare(const pool_index pool_p1,
 		const pool_index pool_p2)
@@ -459,7 +699,16 @@ bool symbol_table::pool_compare(const pool_index pool_p1,
 	// Catch too large pos.
 	assert(pool_p1 < pool_pos && pool_p2 < pool_pos);
 
-	return strcmp(pool_lookup(pool_p1), pool_lookup(pool_p2)) == 0;
+	// Since strings are interned, equal indexes mean equal strings.
+	if (pool_p1 == pool_p2) {
+		return true;
+	}
+
+	pool_string s1 = pool_view(pool_p1);
+	pool_string s2 = pool_view(pool_p2);
+
+	return s1.length == s2.length &&
+		memcmp(s1.chars, s2.chars, s1.length) == 0;
 }
 
 
@@ -467,15 +716,17 @@ bool symbol_table::pool_compare(const pool_index pool_p1,
 
 pool_index symbol_table::pool_forget(const pool_index pool_p)
 {
-	char *last_entry = pool_lookup(pool_p);
+	pool_string last_entry = pool_view(pool_p);
 
 	// Make sure that this really is the last entry.
-	assert((pool_p + (int) strlen(last_entry)) == pool_pos - 1);
+	assert(pool_p + POOL_HEADER_SIZE + last_entry.length == pool_pos);
 
 	// Back up pool_pos one entry.
 	pool_pos = pool_p;
 	// Terminate the string pool there.
 	string_pool[pool_pos] = '\0';
+	// Drop the forgotten string from the interning table as well.
+	intern_rehash(intern_size);
 	// Mostly useful for debugging.
 	return pool_pos;
 }
@@ -514,24 +765,110 @@ char *symbol_table::fix_string(const char *old_str)
 
 
 
+/* Output stream operator for pool strings. Padding is done by hand since
+   ostream::write() ignores the field width. */
+ostream &operator<<(ostream &o, const pool_string &s)
+{
+	streamsize padding = o.width() - s.length;
+	bool left = (o.flags() & ios::adjustfield) == ios::left;
+
+	o.width(0);
+	if (!left) {
+		for (streamsize i = 0; i < padding; i++) {
+			o.put(o.fill());
+		}
+	}
+	o.write(s.chars, s.length);
+	if (left) {
+		for (streamsize i = 0; i < padding; i++) {
+			o.put(o.fill());
+		}
+	}
+	return o;
+}
+
+
+
+
 /*** Hash table methods. ***/
 
-/* Uses the hash_x33 algorithm. Returns an index into the symbol table
-   given a string. The string is probably attained using pool_lookup(). */
-hash_index symbol_table::hash(const pool_index p)
+/* Uses the hash_x33 algorithm. Returns the hash value of a string of length
+   len. This is only done once for each string, when it is installed in the
+   pool. */
+unsigned int symbol_table::hash_x33(const char *s, const long len)
 {
-	char *s = pool_lookup(p);
-	int len = (int) strlen(s);
 	// Magical hash value variable.
 	unsigned int h = 0;
 	// Calculate the hash value.
-	while (len > 0) {
-		h = (h << 5) + h + *s++;
-		len--;
+	for (long i = 0; i < len; i++) {
+		h = (h << 5) + h + s[i];
 	}
-	// Memory leak since s is still allocated. However, since we've
-	// changed it, delete[] s is not a good idea at all.
-	return h % MAX_HASH;
+	return h;
+}
+
+
+/* Returns the full hash value of a string in the pool. It was calculated
+   when the string was installed, so this is O(1). */
+unsigned int symbol_table::pool_hash(const pool_index p)
+{
+	// Catch references to beyond last string.
+	assert(p < pool_pos);
+
+	unsigned int h;
+	memcpy(&h, &string_pool[p + POOL_LENGTH_SIZE], sizeof(h));
+	return h;
+}
+
+
+/* Returns an index into the hash table given a string. */
+hash_index symbol_table::hash(const pool_index p)
+{
+	return pool_hash(p) & (hash_size - 1);
+}
+
+
+/* Double the number of buckets in the hash table. Every chain is sorted
+   with the most recently installed symbol first, which is what close_scope()
+   relies on to unlink a scope's symbols from the chain heads. Since the size
+   is a power of two, each new bucket gets its symbols from exactly one old
+   bucket, so appending them in the order of the old chain keeps the new
+   chains sorted. The back_links are updated to the new buckets. */
+void symbol_table::hash_grow()
+{
+	sym_index *old_table = hash_table;
+	hash_index old_size = hash_size;
+
+	hash_size *= 2;
+	hash_table = new sym_index[hash_size];
+	// Last symbol of each new chain, so we can append to it.
+	sym_index *tails = new sym_index[hash_size];
+	for (hash_index i = 0; i < hash_size; i++) {
+		hash_table[i] = NULL_SYM;
+		tails[i] = NULL_SYM;
+	}
+
+	for (hash_index i = 0; i < old_size; i++) {
+		sym_index sym_p = old_table[i];
+		while (sym_p != NULL_SYM) {
+			symbol *sym = sym_table[sym_p];
+			sym_index next = sym->hash_link;
+			hash_index new_hash = hash(sym->id);
+
+			if (tails[new_hash] == NULL_SYM) {
+				hash_table[new_hash] = sym_p;
+			} else {
+				sym_table[tails[new_hash]]->hash_link = sym_p;
+			}
+			tails[new_hash] = sym_p;
+			sym->hash_link = NULL_SYM;
+			sym->back_link = new_hash;
+
+			sym_p = next;
+		}
+	}
+
+	delete[] tails;
+	delete[] old_table;
 }
 
 
@@ -558,6 +895,9 @@ void symbol_table::open_scope()
 
 	//update the block table for current level
 	block_table[current_level] = sym_pos;
+	// The name of the new block is in the pool by now, the names declared
+	// inside it come after this point.
+	pool_table[current_level] = pool_pos;
 
 }
 
@@ -567,6 +907,7 @@ sym_index symbol_table::close_scope()
 {
   for(sym_index i = sym_pos; i > current_environment(); i--){
     hash_table[sym_table[i]->back_link] = sym_table[i]->hash_link;
+    hash_count--;
   }
   
   block_table[current_level] = 0;
@@ -577,6 +918,42 @@ sym_index symbol_table::close_scope()
 }
 
 
+/* Throw away everything a closed scope left behind. Once the code for a
+   block has been emitted, all that is ever looked at again is the symbol of
+   the procedure or function itself and its parameters, which are needed to
+   type check calls. They were entered right after the procedure symbol, so
+   the rest of the scope - local symbols and the symbols of nested blocks -
+   is simply cut off the end of the symbol table. The strings installed
+   inside the scope are cut off the pool in the same way, unless a surviving
+   parameter still uses them. This keeps the size of the symbol table and
+   the pool proportional to the nesting depth rather than to the size of the
+   program. Must be called right after close_scope(), and only when no
+   string installed inside the scope is still needed by the caller. */
+void symbol_table::release_scope(const sym_index env)
+{
+	// close_scope() has already unlinked the scope from the hash table.
+	assert(env <= sym_pos && sym_table[env]->level == current_level);
+
+	sym_index last = env;
+	long new_pool_pos = pool_table[current_level + 1];
+	while (last < sym_pos && sym_table[last + 1]->tag == SYM_PARAM) {
+		last++;
+		pool_string id = pool_view(sym_table[last]->id);
+		new_pool_pos = max(new_pool_pos,
+				sym_table[last]->id + POOL_HEADER_SIZE + id.length);
+	}
+
+	sym_pos = last;
+	sym_table.release(sym_pos);
+
+	if (new_pool_pos < pool_pos) {
+		pool_pos = new_pool_pos;
+		string_pool[pool_pos] = '\0';
+		intern_rehash(intern_size);
+	}
+}
+
+
 /*** Main symbol table methods. ***/
 
 /* Return a sym_index to the sought symbol (or 0 if none was found), given
@@ -589,7 +966,8 @@ sym_index symbol_table::lookup_symbol(const pool_index pool_p)
   // get the value from the hash table at the hashed index
   sym_index sym_table_index = hash_table[hash_table_index];
   while (sym_table_index != NULL_SYM){
-    if (pool_compare(sym_table[sym_table_index]->id,pool_p)){
+    // Strings are interned, so equal names have equal pool indexes.
+    if (sym_table[sym_table_index]->id == pool_p){
         return sym_table_index;
     }
     sym_table_index = sym_table[sym_table_index]->hash_link;
@@ -630,13 +1008,17 @@ pool_index symbol_table::get_symbol_id(const sym_index sym_p)
 
 /* Given a sym_index, we return the type field of the symbol (which is in
    itself a sym_index to a type symbol). We need to be able to access this
-   information in parser.y, and this is a convenient way to do it. */
+   information in parser.y, and this is a convenient way to do it. It also
+   works for temporaries, which the code generator makes use of. */
 
 sym_index symbol_table::get_symbol_type(const sym_index sym_p)
 {
 	if (sym_p == NULL_SYM) {
 		return void_type;
 	}
+	if (is_temp(sym_p)) {
+		return get_temp(sym_p)->type;
+	}
 
 	return sym_table[sym_p]->type;
 }
@@ -645,12 +1027,16 @@ sym_index symbol_table::get_symbol_type(const sym_index sym_p)
 /* Given a sym_index, we return the tag field of the symbol. This is a
    convenience method used in parser.y so we don't need to explicitly handle
    symbols in it when differing various types of identifiers from one
-   another. */
+   another. Temporaries are reported as variables. */
 sym_type symbol_table::get_symbol_tag(const sym_index sym_p)
 {
 	if (sym_p == NULL_SYM) {
 		return SYM_UNDEF;
 	}
+	// Temporaries behave just like local variables.
+	if (is_temp(sym_p)) {
+		return SYM_VAR;
+	}
 
 	return sym_table[sym_p]->tag;
 }
@@ -683,18 +1069,19 @@ void symbol_table::set_symbol_type(const sym_index sym_p,
 sym_index symbol_table::install_symbol(const pool_index pool_p,
 		const sym_type tag)
 {
-  // If we exceded our limit
-  if (sym_pos >= MAX_SYM) {
-    fatal("MAX_SYM reached");
-  }
-
   sym_index index = lookup_symbol(pool_p);
-  // If we allready have installed it
-  if (index != NULL_SYM && index >= current_environment()) 
+  // If we allready have installed it in this scope. Note that the symbol
+  // of the enclosing procedure belongs to the outer scope, so a local may
+  // share its name.
+  if (index != NULL_SYM && sym_table[index]->level == current_level)
   {
     return index;
   }
 
+  // Make room for the new symbol in the table. The symbol is constructed
+  // right in its slot rather than being allocated on its own.
+  void *slot = sym_table.reserve(sym_pos + 1);
+
   /*
     pointer of base class for symbols,
     makes it easier to handle all the different symbols
@@ -704,36 +1091,43 @@ sym_index symbol_table::install_symbol(const pool_index pool_p,
 
   switch (tag) {
   case SYM_ARRAY:
-    new_symbol = new array_symbol(pool_p);
+    new_symbol = new (slot) array_symbol(pool_p);
     break;
   case SYM_FUNC:
-    new_symbol = new function_symbol(pool_p);
+    new_symbol = new (slot) function_symbol(pool_p);
     break;
   case SYM_PROC:
-    new_symbol = new procedure_symbol(pool_p);
+    new_symbol = new (slot) procedure_symbol(pool_p);
     break;
   case SYM_VAR:
-    new_symbol = new variable_symbol(pool_p);
+    new_symbol = new (slot) variable_symbol(pool_p);
     break;
   case  SYM_PARAM:
-    new_symbol = new parameter_symbol(pool_p);
+    new_symbol = new (slot) parameter_symbol(pool_p);
     break;
   case SYM_CONST:
-    new_symbol = new constant_symbol(pool_p);
+    new_symbol = new (slot) constant_symbol(pool_p);
     break;
   case SYM_NAMETYPE:
-    new_symbol = new nametype_symbol(pool_p);
+    new_symbol = new (slot) nametype_symbol(pool_p);
     break;
   case SYM_UNDEF:
     fatal("undefined symboltype");
-    break;
+    return NULL_SYM;
   default:
     fatal("unknown symboltype");
+    return NULL_SYM;
   }
 
-  // Update the global symbol pointer to point to the last entry
+  // Update the global symbol pointer to point to the last entry.
   sym_pos++;
 
+  // Keep the hash chains short by growing the hash table before it gets
+  // too full. This has to be done before hashing the new symbol.
+  if (++hash_count > hash_size * MAX_HASH_LOAD) {
+    hash_grow();
+  }
+
   // get the hash value
   hash_index new_hash = hash(pool_p);
   // Fill the new symbol with known parameters
@@ -744,7 +1138,6 @@ sym_index symbol_table::install_symbol(const pool_index pool_p,
   // set the offset? need to lookup
   // new_symbol->offset = ?;
   sym_index new_sym_pos = sym_pos;
-  sym_table[new_sym_pos] = new_symbol;
   hash_table[new_hash] = new_sym_pos;
   return new_sym_pos;
 }
@@ -777,7 +1170,6 @@ sym_index symbol_table::enter_constant(position_information *pos,
 	con->tag = SYM_CONST;
 
 	con->const_value.ival = ival;
-	sym_table[sym_p] = con;
 
 	return sym_p;
 }
@@ -815,8 +1207,6 @@ sym_index symbol_table::enter_constant(position_information *pos,
 	con->tag = SYM_CONST;
 	con->const_value.rval = rval;
 
-	sym_table[sym_p] = con;
-
 	return sym_p;
 }
 
@@ -866,16 +1256,12 @@ sym_index symbol_table::enter_variable(position_information *pos,
 		function_symbol *cur_func = tmp->get_function_symbol();
 		var->offset = cur_func->ar_size;
 		cur_func->ar_size += get_size(type);
-		sym_table[current_environment()] = cur_func;
 	} else {
 		procedure_symbol *cur_proc = tmp->get_procedure_symbol();
 		var->offset = cur_proc->ar_size;
 		cur_proc->ar_size += get_size(type);
-		sym_table[current_environment()] = cur_proc;
 	}
 
-	sym_table[sym_p] = var;
-
 	return sym_p;
 }
 
@@ -940,15 +1326,12 @@ sym_index symbol_table::enter_array(position_information *pos,
 			function_symbol *cur_func = tmp->get_function_symbol();
 			arr->offset = cur_func->ar_size;
 			cur_func->ar_size += cardinality * get_size(type);
-			sym_table[current_environment()] = cur_func;
 		} else {
 			procedure_symbol *cur_proc = tmp->get_procedure_symbol();
 			arr->offset = cur_proc->ar_size;
 			cur_proc->ar_size += cardinality * get_size(type);
-			sym_table[current_environment()] = cur_proc;
 		}
 	}
-	sym_table[sym_p] = arr;
 
 	return sym_p;
 }
@@ -982,8 +1365,6 @@ sym_index symbol_table::enter_function(position_information *pos,
 	func->ar_size = 0;
 	func->label_nr = get_next_label();
 
-	sym_table[sym_p] = func;
-
 	return sym_p;
 }
 
@@ -1005,6 +1386,9 @@ sym_index symbol_table::enter_procedure(position_information *pos,
 
   // Set up the function-specific fields
   func->tag = SYM_PROC;
+  // Procedures don't return anything. Without this the type field is
+  // left uninitialized, which the AST printout trips over.
+  func->type = void_type;
   // Parameters are added later on
   func->last_parameter = NULL;
 
@@ -1012,8 +1396,6 @@ sym_index symbol_table::enter_procedure(position_information *pos,
   func->ar_size = 0;
   func->label_nr = get_next_label();
 
-  sym_table[sym_p] = func;
-
   return sym_p;
 
   /*
@@ -1101,8 +1483,6 @@ sym_index symbol_table::enter_parameter(position_information *pos,
 	par->size = get_size(type);
 	par->type = type;
 
-	sym_table[sym_p] = par;
-
 	return sym_p;
 }
 
@@ -39,14 +39,31 @@ typedef enum symbol_types sym_type;
 // Max allowed nesting levels.
 const block_level MAX_BLOCK = 8;
 
-// Max size of hash table.
-const hash_index MAX_HASH = 512;
+// Base size of hash table. Must be a power of two.
+const hash_index BASE_HASH_SIZE = 512;
+
+// Max average number of symbols per hash bucket. When it would be exceeded,
+// the hash table is doubled in size.
+const long MAX_HASH_LOAD = 1;
 
 // Base size of string pool.
 const pool_index BASE_POOL_SIZE = 1024;
 
-// Max size of symbol table.
-const sym_index MAX_SYM = 1024;
+// Bytes in front of each string in the pool: its length and its hash value,
+// which follows the length byte.
+const long POOL_LENGTH_SIZE = 1;
+const long POOL_HEADER_SIZE = POOL_LENGTH_SIZE + sizeof(unsigned int);
+
+// Base size of the string interning table. Must be a power of two.
+const long BASE_INTERN_SIZE = 256;
+
+// Number of symbols in each chunk of the symbol table. The table grows one
+// chunk at a time, so symbols never have to be moved. Must be a power of two.
+const sym_index SYM_CHUNK_SIZE = 1024;
+
+// Base number of chunks the symbol table has room for before its chunk
+// directory needs to grow.
+const long BASE_SYM_CHUNKS = 16;
 
 // Signifies 'no symbol'.
 const sym_index NULL_SYM = -1;
@@ -54,11 +71,18 @@ const sym_index NULL_SYM = -1;
 // Signifies a non-int array size.
 const int ILLEGAL_ARRAY_CARD = -1;
 
-/* Sets a limit for max nr of temporary variables. Should never be reached
-   unless someone really, really starts to dig writing huge programs in
-   Diesel. See quads.cc. */
-const int MAX_TEMP_VARS = 999999;
-const int MAX_TEMP_VAR_LENGTH = 8;
+// Signifies that a variable or temporary is kept in memory rather than in a
+// register. See the register numbering in codegen.hh.
+const int NO_REGISTER = -1;
+
+/* Temporary variables aren't symbols, but quads refer to them through the
+   same sym_index arguments as symbols. Temporary number n is represented by
+   TEMP_BASE + n, which no real symbol index will ever reach. It is small
+   enough for the int arguments of a quadruple. See quads.hh. */
+const sym_index TEMP_BASE = 1L << 30;
+
+// Base size of the table of temporary variables.
+const long BASE_TEMP_SIZE = 256;
 
 /* The various symbol classes, predefined. */
 class constant_symbol;
@@ -76,6 +100,38 @@ extern symbol_table *sym_tab;
 
 
 
+/* A view of a string in the string pool: its first character and its
+   length. Getting one from symbol_table::pool_view() doesn't allocate
+   anything. Note that the characters are not null terminated, and that the
+   view is only valid until the pool grows, ie, the next pool_install(). */
+struct pool_string {
+    const char *chars;
+    int length;
+};
+
+/* Allow a pool string to be sent to an outstream. Honours setw(). */
+ostream &operator<<(ostream &, const pool_string &);
+
+
+/* A temporary variable, holding an intermediate value during quad generation
+   and code generation. All it needs is a type and a place in the activation
+   record of the block it belongs to. */
+struct temp_info {
+    // Type: integer_type or real_type.
+    sym_index type;
+
+    // Block level, ie, nesting depth, of the block the temporary belongs to.
+    block_level level;
+
+    // Offset in the activation record, used in code generation.
+    int offset;
+
+    // Register holding the temporary, or NO_REGISTER.
+    int reg;
+};
+
+
+
 /* Global symbol table variables. These indexes point to symbols in the symbol
    table which represent information about types. Declared "for real" in
    symbol.cc. */
@@ -92,13 +148,16 @@ extern sym_index real_type;
 
 /* The symbol table consists of entries of subclasses to symbol. This class
    contains data that are common to all symbol types.
-   This class is never used directly. Use the derived classes instead. */
+   This class is never used directly. Use the derived classes instead.
+   None of the symbol classes have virtual methods. Which subclass a symbol
+   belongs to is recorded in its kind field instead, which keeps the symbols
+   small and lets the symbol table store them by value, see symbol_storage. */
 class symbol
 {
 protected:
     // Every symbol must define a print method, which is called when the
-    // symbol is sent to an outstream.
-    virtual void print(ostream &);
+    // symbol is sent to an outstream. This one prints the common fields.
+    void print(ostream &);
 
     // This is used later on to control the level of detail given when printing
     // a symbol. If you're not used to C++, don't worry: You don't really need
@@ -122,6 +181,10 @@ public:
     // Describes what kind of symbol this is.
     sym_type tag;
 
+    // Which subclass this symbol is an instance of. Unlike tag, which is
+    // SYM_UNDEF until the symbol has been entered, this is set on creation.
+    sym_type kind;
+
     // Type: integer_type, real_type, or void_type.
     sym_index type;
 
@@ -137,50 +200,28 @@ public:
     // Offset, used in code generation.
     int offset;
 
-    // Constructor.
-    symbol(pool_index);
+    // Constructor. Args: identifier, kind.
+    symbol(pool_index, sym_type);
 
     // Currently lacks print method/operator.
     // Currently lacks some other needed stuff like conversions to and
     //   from strings.
 
-    // These functions must be defined by the appropriate subclasses to
-    // return a symbol of the correct type. This is to be able to ensure
-    // safe downcasts in C++, since we don't want to rely on RTTI information
-    // which isn't as of yet supported in all compilers.
-    // Calling the method in this class is considered an error and will cause
-    // the compiler to abort. It should only be called in a derived class.
-    // The "return NULL;" lines are just there to avoid compiler warnings.
-    virtual constant_symbol *get_constant_symbol() {
-        fatal("Illegal downcasting to constant from symbol class");
-        return NULL;
-    }
-    virtual variable_symbol *get_variable_symbol() {
-        fatal("Illegal downcasting to variable from symbol class");
-        return NULL;
-    }
-    virtual array_symbol *get_array_symbol() {
-        fatal("Illegal downcasting to array from symbol class");
-        return NULL;
-    }
-    virtual parameter_symbol *get_parameter_symbol() {
-        fatal("Illegal downcasting to parameter from symbol class");
-        return NULL;
-    }
-    virtual procedure_symbol *get_procedure_symbol() {
-        fatal("Illegal downcasting to procedure from symbol class");
-        return NULL;
-    }
-    virtual function_symbol *get_function_symbol() {
-        fatal("Illegal downcasting to function from symbol class");
-        return NULL;
-    }
-    virtual nametype_symbol *get_nametype_symbol() {
-        fatal("Illegal downcasting to nametype from symbol class");
-        return NULL;
-    }
-
-    // Allow us to print a symbol by sending it to an outstream.
+    // Safe downcasts from symbol to the correct subclass. They check the
+    // kind of the symbol, and calling the wrong one is considered an error
+    // and will cause the compiler to abort. This is to be able to ensure
+    // safe downcasts in C++ without relying on RTTI or virtual methods.
+    constant_symbol *get_constant_symbol();
+    variable_symbol *get_variable_symbol();
+    array_symbol *get_array_symbol();
+    parameter_symbol *get_parameter_symbol();
+    procedure_symbol *get_procedure_symbol();
+    function_symbol *get_function_symbol();
+    nametype_symbol *get_nametype_symbol();
+
+    // Allow us to print a symbol by sending it to an outstream. It looks at
+    // kind to call the print method of the right subclass, so every subclass
+    // declares it as a friend too.
     friend ostream &operator<<(ostream &, symbol *);
 };
 
@@ -189,7 +230,9 @@ public:
 class constant_symbol: public symbol
 {
 protected:
-    virtual void print(ostream &);
+    void print(ostream &);
+
+    friend ostream &operator<<(ostream &, symbol *);
 
 public:
     // Value of constant, can be int or float.
@@ -197,11 +240,6 @@ public:
 
     // Constructor. Arguments: Identifier.
     constant_symbol(const pool_index);
-
-    // Used to be able to safely downcast from symbol to constant_symbol.
-    virtual constant_symbol *get_constant_symbol() {
-        return this;
-    }
 };
 
 
@@ -209,16 +247,17 @@ public:
 class variable_symbol: public symbol
 {
 protected:
-    virtual void print(ostream &);
+    void print(ostream &);
+
+    friend ostream &operator<<(ostream &, symbol *);
 
 public:
+    // Register holding the variable instead of its slot in the activation
+    // record, or NO_REGISTER. Set by the quad optimizer.
+    int reg;
+
     // Constructor. Args: identifier.
     variable_symbol(const pool_index);
-
-    // Used to be able to safely downcast from symbol to variable_symbol.
-    virtual variable_symbol *get_variable_symbol() {
-        return this;
-    }
 };
 
 
@@ -226,7 +265,9 @@ public:
 class array_symbol: public symbol
 {
 protected:
-    virtual void print(ostream &);
+    void print(ostream &);
+
+    friend ostream &operator<<(ostream &, symbol *);
 
 public:
     // Points to the index type in the symbol table.
@@ -237,11 +278,6 @@ public:
 
     // Constructor. Args: identifier.
     array_symbol(const pool_index);
-
-    // Used to be able to safely downcast from symbol to array_symbol.
-    virtual array_symbol *get_array_symbol() {
-        return this;
-    }
 };
 
 
@@ -249,7 +285,9 @@ public:
 class parameter_symbol: public symbol
 {
 protected:
-    virtual void print(ostream &);
+    void print(ostream &);
+
+    friend ostream &operator<<(ostream &, symbol *);
 
 public:
     // Nr of bytes parameter needs.
@@ -260,11 +298,6 @@ public:
 
     // Constructor. Args: identifier.
     parameter_symbol(const pool_index);
-
-    // Used to be able to safely downcast from symbol to parameter_symbol.
-    virtual parameter_symbol *get_parameter_symbol() {
-        return this;
-    }
 };
 
 
@@ -272,7 +305,9 @@ public:
 class procedure_symbol: public symbol
 {
 protected:
-    virtual void print(ostream &);
+    void print(ostream &);
+
+    friend ostream &operator<<(ostream &, symbol *);
 
 public:
     // Activation record size.
@@ -287,11 +322,6 @@ public:
 
     // Constructor. Args: identifier.
     procedure_symbol(const pool_index);
-
-    // Used to be able to safely downcast from symbol to procedure_symbol.
-    virtual procedure_symbol *get_procedure_symbol() {
-        return this;
-    }
 };
 
 
@@ -299,7 +329,9 @@ public:
 class function_symbol: public symbol
 {
 protected:
-    virtual void print(ostream &);
+    void print(ostream &);
+
+    friend ostream &operator<<(ostream &, symbol *);
 
 public:
     // Activation record size.
@@ -314,11 +346,6 @@ public:
 
     // Constructor. Args: identifier.
     function_symbol(const pool_index);
-
-    // Used to be able to safely downcast from symbol to function_symbol.
-    virtual function_symbol *get_function_symbol() {
-        return this;
-    }
 };
 
 
@@ -328,17 +355,14 @@ public:
 class nametype_symbol: public symbol
 {
 protected:
-    virtual void print(ostream &);
+    void print(ostream &);
+
+    friend ostream &operator<<(ostream &, symbol *);
 
 public:
 
     // Constructor. Args: identifier.
     nametype_symbol(const pool_index);
-
-    // Used to be able to safely downcast from symbol to nametype_symbol.
-    virtual nametype_symbol *get_nametype_symbol() {
-        return this;
-    }
 };
 
 
@@ -363,6 +387,45 @@ ostream &operator<<(ostream &, symbol *);
  ******************************/
 
 
+/* Storage for the symbols of the symbol table. It is indexed just like an
+   array, but is made up of fixed size chunks that are allocated as needed,
+   so it can hold any number of symbols. The symbols are stored by value in
+   equally sized slots, so symbols entered after each other lie next to each
+   other in memory rather than wherever the heap put them. A chunk is never
+   moved once allocated; only the (small) directory of chunk pointers is ever
+   reallocated. This means that both a sym_index and a symbol pointer stay
+   valid until the symbol is released together with its scope. */
+class symbol_storage
+{
+private:
+    // Directory of chunks, each holding SYM_CHUNK_SIZE slots.
+    char **chunks;
+
+    // Number of chunks allocated.
+    long chunk_count;
+
+    // Number of entries in the chunk directory.
+    long directory_size;
+
+    // Size of a slot, ie, of the largest symbol subclass.
+    size_t slot_size;
+
+public:
+    symbol_storage();
+
+    // Make sure there is room for a symbol with the given index, and return
+    // the slot it should be constructed in.
+    void *reserve(const sym_index);
+
+    // Get the symbol with a given index. It must be reserved.
+    symbol *operator[](const sym_index);
+
+    // Free the chunks that aren't needed for symbols up to a given index.
+    void release(const sym_index);
+};
+
+
+
 /* The symbol table. Presents an interfaced used by parser.y.
    The idea is that in parser.y, the code will look something like this:
    NOTE: Fix this comment.
@@ -392,11 +455,43 @@ private:
     // Points to end of string pool
     long pool_pos;
 
+    // Calculate the hash_x33 value of a string of a given length.
+    unsigned int hash_x33(const char *, const long);
+
+    // --- String interning variables. ---
+
+    // Open addressing table holding the pool_index of every distinct string
+    // in the pool, so that equal strings share a single pool entry.
+    pool_index *intern_table;
+
+    // Number of slots in intern_table. Always a power of two.
+    long intern_size;
+
+    // Number of strings entered into intern_table.
+    long intern_count;
+
+    // Find the intern_table slot holding a string, or the empty slot where
+    // it would go.
+    long intern_slot(const char *, const long, const unsigned int);
+
+    // Resize intern_table and re-enter all strings in the pool.
+    void intern_rehash(const long);
+
     // --- Hash table variables. ---
 
     // The actual hash table.
     sym_index *hash_table;
 
+    // Number of buckets in hash_table. Always a power of two.
+    hash_index hash_size;
+
+    // Number of symbols currently linked into hash_table, ie, the symbols
+    // of all open scopes.
+    long hash_count;
+
+    // Double the size of hash_table, relinking the symbols into it.
+    void hash_grow();
+
     // --- Display variables. ---
 
     // Current nesting depth.
@@ -406,10 +501,14 @@ private:
     // the start of a new scope/block.
     sym_index *block_table;
 
+    // The pool_pos of each level at the time its scope was opened. Strings
+    // installed after that may be released together with the scope.
+    long *pool_table;
+
     // --- Symbol table variables. ---
 
     // The actual symbol table.
-    symbol **sym_table;
+    symbol_storage sym_table;
 
     // Points to last symbol entered in the table.
     sym_index sym_pos;
@@ -417,6 +516,15 @@ private:
     // Assembler label counter.
     int label_nr;
 
+    // --- Temporary variables. ---
+
+    // The temporaries of the block quads are being generated for, indexed
+    // by temporary number.
+    temp_info *temp_table;
+
+    // Number of entries in temp_table.
+    long temp_size;
+
     // Temp variable counter.
     long temp_nr;
 
@@ -435,9 +543,18 @@ public:
 
     // --- String pool methods. ---
 
-    // Install a string in the pool.
+    // Install a string in the pool, or return the index of an already
+    // installed, equal string.
     pool_index pool_install(char *);
 
+    // Install a capitalized copy of an identifier. Used by the scanner.
+    pool_index pool_install_identifier(const char *);
+
+    // Return a view of a string in the pool. Doesn't allocate.
+    pool_string pool_view(const pool_index);
+
+    // Return a newly allocated, null terminated copy of a string in the pool.
+    // Prefer pool_view() unless the copy really is needed.
     char *pool_lookup(const pool_index);
 
      // Compare strings
@@ -457,6 +574,9 @@ public:
     // Get hash value for a string.
     hash_index hash(const pool_index);
 
+    // Get the full hash value stored for a string when it was installed.
+    unsigned int pool_hash(const pool_index);
+
     // --- Display methods. ---
 
     // Return sym_index to current procedure or function
@@ -467,6 +587,10 @@ public:
 
     sym_index close_scope();
 
+    // Release the symbols and strings of a scope that has been closed and
+    // whose code has been emitted. Arg: the scope's procedure or function.
+    void release_scope(const sym_index);
+
     // --- Symbol table methods. ---
 
     sym_index lookup_symbol(const pool_index);
@@ -494,9 +618,18 @@ public:
     // Generate next asm label.
     long get_next_label();
 
-    // Generate, install and return sym_index to next temp var.
+    // Generate and return sym_index to next temp var. Arg: type.
     sym_index gen_temp_var(sym_index);
 
+    // Forget all temporaries. Done before generating quads for a new block.
+    void reset_temps();
+
+    // Return true if a sym_index refers to a temporary rather than a symbol.
+    bool is_temp(const sym_index);
+
+    // Get the information about a temporary.
+    temp_info *get_temp(const sym_index);
+
     // These functions are used to enter identifiers into the symbol table,
     // depending on their context (function, constant, etc).
 
@@ -518,8 +651,8 @@ public:
                              const pool_index,
                              const sym_index);
 
-    // This convenience method is used for installing temporary variables for
-    // which position information is not relevant. See quads.cc.
+    // This convenience method is used for installing variables for which
+    // position information is not relevant.
     sym_index enter_variable(const pool_index, const sym_index);
 
     // Args: Position information, identifier, array type pointer,
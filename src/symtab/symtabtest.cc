@@ -1,6 +1,7 @@
 #include <iostream>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "scanner.hh"
 #include "symtab.hh"
 
@@ -19,6 +20,13 @@ using namespace std;
 // Test all enter_ methods in the symbol table.
 #define TEST_TRACE2 0
 
+// Install a lot of symbols and report how fast they can be installed and
+// looked up. Skips the symbol table printouts at the end.
+#define TEST_STRESS 0
+
+// Number of symbols installed by TEST_STRESS.
+#define STRESS_SYMBOLS 1000000
+
 
 YYSTYPE yylval;
 YYLTYPE yylloc;
@@ -150,6 +158,66 @@ int main(int argc, char **argv) {
 
     cout << "Current environment: " << sym_tab->current_environment() << endl;
 #endif
+
+/* Install STRESS_SYMBOLS variables in a procedure scope and look all of them
+   up again, reporting the throughput of both. This also checks that neither
+   sym_index values nor symbol pointers change as the symbol table grows. */
+
+#if TEST_STRESS
+    {
+        char name[32];
+        pool_index *names = new pool_index[STRESS_SYMBOLS];
+        sym_index *syms = new sym_index[STRESS_SYMBOLS];
+
+        sym_tab->enter_procedure(pos, sym_tab->pool_install("stress_proc"));
+        sym_tab->open_scope();
+
+        // The strings are installed beforehand so that only the symbol table
+        // operations are timed.
+        for (long i = 0; i < STRESS_SYMBOLS; i++) {
+            sprintf(name, "STRESS_%ld", i);
+            names[i] = sym_tab->pool_install(name);
+        }
+
+        clock_t start = clock();
+        for (long i = 0; i < STRESS_SYMBOLS; i++) {
+            syms[i] = sym_tab->enter_variable(pos, names[i], integer_type);
+        }
+        clock_t installed = clock();
+
+        symbol *first = sym_tab->get_symbol(syms[0]);
+        long errors = 0;
+        for (long i = 0; i < STRESS_SYMBOLS; i++) {
+            if (sym_tab->lookup_symbol(names[i]) != syms[i]) {
+                errors++;
+            }
+        }
+        clock_t looked_up = clock();
+
+        if (sym_tab->get_symbol(syms[0]) != first) {
+            errors++;
+        }
+
+        double install_time = (double) (installed - start) / CLOCKS_PER_SEC;
+        double lookup_time = (double) (looked_up - installed) / CLOCKS_PER_SEC;
+        cout << "Installed " << STRESS_SYMBOLS << " symbols in "
+             << install_time << " s ("
+             << (long) (STRESS_SYMBOLS / install_time) << " symbols/s)\n";
+        cout << "Looked up " << STRESS_SYMBOLS << " symbols in "
+             << lookup_time << " s ("
+             << (long) (STRESS_SYMBOLS / lookup_time) << " symbols/s)\n";
+        cout << "Lookup errors: " << errors << endl;
+
+        sym_tab->close_scope();
+
+        delete[] names;
+        delete[] syms;
+
+        cout << "ENDING TEST PROGRAM RUN -----------------------------\n\n\n\n";
+        return 1;
+    }
+#endif
+
     sym_tab->print(2);
     sym_tab->print(1);
 